@@ -0,0 +1,190 @@
+#include "array.hpp"
+#include <cstdint>
+#include <typeinfo>
+#include <vector>
+namespace array
+{
+const char DECLARATION[] = "INT";
+const long MAX_ELEMENTS = 1 << 20;
+// base of a chain of subscripts; idx gets the indices, first one first
+expr::expr &unwind(expr::expr &e,
+		std::vector<std::unique_ptr<expr::expr> *> &idx)
+{
+	expr::expr *cur = &e;
+	while (typeid(*cur) == typeid(expr::subscript))
+	{
+		auto &sub = static_cast<expr::subscript&>(*cur);
+		idx.insert(idx.begin(), &sub.rc);
+		cur = sub.lc.get();
+	}
+	return *cur;
+}
+// dimensions if val is INT[d1][d2]..., none otherwise
+std::vector<int> declared_dims(expr::expr &val)
+{
+	std::vector<std::unique_ptr<expr::expr> *> idx;
+	const auto &base = unwind(val, idx);
+	if (idx.empty() || typeid(base) != typeid(expr::id)
+			|| static_cast<const expr::id&>(base).id_name != DECLARATION)
+		return {};
+	std::vector<int> ret;
+	long total = 1;
+	for (auto i : idx)
+	{
+		if (typeid(**i) != typeid(expr::imm_num)
+				|| static_cast<expr::imm_num&>(**i).value <= 0)
+			throw "Array size must be a positive constant.";
+		ret.push_back(static_cast<expr::imm_num&>(**i).value);
+		if ((total *= ret.back()) > MAX_ELEMENTS)
+			throw "Array too large.";
+	}
+	return ret;
+}
+// moves the constant terms of e (x + k, k + x, x - k) into c; wraps like
+// the code computing them
+void peel(std::unique_ptr<expr::expr> &e, uint32_t &c)
+{
+	for (;;)
+	{
+		const auto &type = typeid(*e);
+		if (type != typeid(expr::add) && type != typeid(expr::sub))
+			return;
+		auto &op = static_cast<expr::bin_op&>(*e);
+		std::unique_ptr<expr::expr> rest;
+		if (typeid(*op.rc) == typeid(expr::imm_num))
+		{
+			uint32_t k = static_cast<expr::imm_num&>(*op.rc).value;
+			c += type == typeid(expr::add) ? k : -k;
+			rest = std::move(op.lc);
+		}
+		else if (type == typeid(expr::add)
+				&& typeid(*op.lc) == typeid(expr::imm_num))
+		{
+			c += static_cast<expr::imm_num&>(*op.lc).value;
+			rest = std::move(op.rc);
+		}
+		else
+			return;
+		e = std::move(rest);
+	}
+}
+struct lowering
+{
+	std::map<std::string, std::vector<int>> dims;
+	void rewrite(std::unique_ptr<expr::expr> &slot)
+	{
+		const auto &type = typeid(*slot);
+		if (type == typeid(expr::id))
+		{
+			if (dims.count(static_cast<expr::id&>(*slot).id_name) != 0)
+				throw "Array used without subscript.";
+			return;
+		}
+		if (type == typeid(expr::imm_num))
+			return;
+		if (type == typeid(expr::neg))
+			return rewrite(static_cast<expr::neg&>(*slot).c);
+		if (type != typeid(expr::subscript))
+		{
+			rewrite(static_cast<expr::bin_op&>(*slot).lc);
+			rewrite(static_cast<expr::bin_op&>(*slot).rc);
+			return;
+		}
+		std::vector<std::unique_ptr<expr::expr> *> idx;
+		const auto &base = unwind(*slot, idx);
+		auto it = typeid(base) == typeid(expr::id)
+			? dims.find(static_cast<const expr::id&>(base).id_name)
+			: dims.end();
+		if (it == dims.end())
+			throw "Unknown array.";
+		const auto &d = it->second;
+		if (idx.size() != d.size())
+			throw "Wrong number of subscripts.";
+		std::unique_ptr<expr::expr> dyn;
+		uint32_t c = 0;
+		for (size_t k = 0; k < d.size(); ++k)
+		{
+			auto &i = *idx[k];
+			rewrite(i);
+			uint32_t v = 0;
+			peel(i, v);
+			if (typeid(*i) == typeid(expr::imm_num))
+			{
+				v += static_cast<expr::imm_num&>(*i).value;
+				if (int(v) < 0 || int(v) >= d[k])
+					throw "Array index out of bounds.";
+				i = nullptr;
+			}
+			if (dyn != nullptr && d[k] != 1)
+				dyn = std::make_unique<expr::mul>(std::move(dyn),
+						std::make_unique<expr::imm_num>(d[k]));
+			c = c * d[k] + v;
+			if (i == nullptr)
+				continue;
+			if (dyn == nullptr)
+				dyn = std::move(i);
+			else
+				dyn = std::make_unique<expr::add>(std::move(dyn), std::move(i));
+		}
+		std::unique_ptr<expr::expr> flat;
+		if (dyn == nullptr)
+			flat = std::make_unique<expr::imm_num>(int(c));
+		else if (c != 0)
+			flat = std::make_unique<expr::add>(std::move(dyn),
+					std::make_unique<expr::imm_num>(int(c)));
+		else
+			flat = std::move(dyn);
+		slot = std::make_unique<expr::subscript>
+			(std::make_unique<expr::id>(it->first), std::move(flat));
+	}
+	void rewrite(statement::assignment &assign)
+	{
+		rewrite(assign.var);
+		rewrite(assign.val);
+	}
+};
+sizes lower(statement::program_type &prog)
+{
+	lowering l;
+	sizes ret;
+	// declarations hold wherever they are, so they are collected first
+	for (auto &[line, sent] : prog)
+	{
+		if (typeid(*sent) != typeid(statement::LET))
+			continue;
+		const auto &assign = static_cast<statement::LET&>(*sent).assign;
+		auto &&d = declared_dims(*assign.val);
+		if (d.empty())
+			continue;
+		if (typeid(*assign.var) != typeid(expr::id))
+			throw "Array name expected.";
+		const auto &name = static_cast<expr::id&>(*assign.var).id_name;
+		auto &&[it, inserted] = l.dims.emplace(name, d);
+		if (!inserted && it->second != d)
+			throw "Array redeclared with different size.";
+		int total = 1;
+		for (int x : d)
+			total *= x;
+		ret[name] = total;
+		sent = std::make_unique<statement::REM>();
+	}
+	for (auto &[line, sent] : prog)
+	{
+		const auto &type = typeid(*sent);
+		if (type == typeid(statement::LET))
+			l.rewrite(static_cast<statement::LET&>(*sent).assign);
+		else if (type == typeid(statement::END_FOR))
+			l.rewrite(static_cast<statement::END_FOR&>(*sent).step_statement);
+		else if (type == typeid(statement::INPUT))
+			for (auto &var : static_cast<statement::INPUT&>(*sent).inputs)
+				l.rewrite(var);
+		else if (type == typeid(statement::EXIT))
+			l.rewrite(static_cast<statement::EXIT&>(*sent).val);
+		else if (type == typeid(statement::IF))
+			l.rewrite(static_cast<statement::IF&>(*sent).condition);
+		else if (type == typeid(statement::FOR))
+			l.rewrite(static_cast<statement::FOR&>(*sent).condition);
+	}
+	return ret;
+}
+}
@@ -0,0 +1,19 @@
+#ifndef ARRAY_HPP
+#define ARRAY_HPP
+#include "statement.hpp"
+#include <map>
+#include <string>
+namespace array
+{
+using sizes = std::map<std::string, int>; // array -> elements
+/*
+ * LET A = INT[d1][d2]... declares A as a static, zeroed array of d1 * d2 * ...
+ * elements, wherever the statement is; it runs no code and is replaced by
+ * {rem}.  Every A[i1][i2]... becomes A[flat] with one multiply-add chain
+ * flat = (i1 * d2 + i2) * d3 + ..., its constant part folded.  Constant
+ * indices are checked against the bounds here; others are not checked by
+ * the compiled code.
+ */
+sizes lower(statement::program_type &prog);
+}
+#endif
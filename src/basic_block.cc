@@ -21,23 +21,24 @@ inline void add_edge_to(num_cfg_type &m, int u, int v)
 	++m[v].in_edge_cnt;
 }
 num_cfg_type::iterator
-remove_sent(num_cfg_type &m, int x, const program_type &prog)
+remove_sent(num_cfg_type &m, int x, const program_type &prog,
+		std::ostream &log)
 {
 	if (x != statement::additional_exit_line)
-		std::clog << "Warning: unreachable code at line " << x << std::endl;
+		log << "Warning: unreachable code at line " << x << std::endl;
 	if (typeid(*(prog.at(x))) == typeid(statement::LET))
-		std::clog << "Warning: remove unreachable LET. It may cause error."
+		log << "Warning: remove unreachable LET. It may cause error."
 			<< std::endl;
 	for (int i = 0; i < m[x].out_edge_cnt; ++i)
 	{
 		auto v = m[x].out_edge[i];
 		auto &v_in_cnt = m[v].in_edge_cnt;
 		if (--v_in_cnt == 0)
-			remove_sent(m, v, prog);
+			remove_sent(m, v, prog, log);
 	}
 	return m.erase(m.find(x));
 }
-num_cfg_type gen_num_cfg(const program_type &prog)
+num_cfg_type gen_num_cfg(const program_type &prog, std::ostream &log)
 {
 	num_cfg_type ret;
 	ret.emplace(BEGIN_IDX, simple_block());
@@ -83,7 +84,7 @@ num_cfg_type gen_num_cfg(const program_type &prog)
 	add_edge_to(ret, BEGIN_IDX, prog.cbegin()->first);
 	for (auto it = ret.lower_bound(0); it != ret.end(); )
 		if (it->second.in_edge_cnt == 0)
-			it = remove_sent(ret, it->first, prog);
+			it = remove_sent(ret, it->first, prog, log);
 		else
 			++it;
 	for (auto it = ret.lower_bound(0); it != ret.end(); ++it)
@@ -107,9 +108,16 @@ num_cfg_type gen_num_cfg(const program_type &prog)
 	}
 	return ret;
 }
-cfg_type gen_cfg(const program_type &prog)
+cfg_type gen_cfg(const program_type &prog, std::ostream &log)
 {
-	const auto &simple_cfg = gen_num_cfg(prog);
+	program_type copy;
+	for (const auto &[line, sent] : prog)
+		copy.emplace(line, sent->deep_copy());
+	return gen_cfg(std::move(copy), log);
+}
+cfg_type gen_cfg(program_type &&prog, std::ostream &log)
+{
+	const auto &simple_cfg = gen_num_cfg(prog, log);
 	cfg_type ret;
 	for (auto &&num_cfg_node = simple_cfg.lower_bound(0);
 			num_cfg_node != simple_cfg.cend();
@@ -117,7 +125,11 @@ cfg_type gen_cfg(const program_type &prog)
 	{
 		std::vector<std::unique_ptr<statement::statement>> block_statement;
 		for (const auto &line : num_cfg_node->second.lines)
-			block_statement.push_back(prog.at(line)->deep_copy());
+		{
+			auto it = prog.find(line);
+			block_statement.push_back(std::move(it->second));
+			prog.erase(it);
+		}
 		const auto &last_sent = block_statement.back();
 		const auto &sent_type = typeid(*last_sent);
 		std::unique_ptr<expr::expr> condition = nullptr;
@@ -143,6 +155,7 @@ cfg_type gen_cfg(const program_type &prog)
 				(std::move(block_statement), std::move(condition),
 				 jump_true, jump_false));
 	}
+	prog.clear();
 	return ret;
 }
 void print_cfg(std::ostream &os, const cfg_type &cfg)
@@ -162,4 +175,258 @@ void print_cfg(std::ostream &os, const cfg_type &cfg)
 	}
 	os << std::endl;
 }
+std::vector<int> successors(const basic_block_type &block)
+{
+	std::vector<int> ret;
+	if (block.jump_true != END_IDX)
+		ret.push_back(block.jump_true);
+	if (block.condition != nullptr && block.jump_false != END_IDX
+			&& block.jump_false != block.jump_true)
+		ret.push_back(block.jump_false);
+	return ret;
+}
+std::map<int, std::vector<int>> gen_predecessors(const cfg_type &cfg)
+{
+	std::map<int, std::vector<int>> ret;
+	for (const auto &[id, block] : cfg)
+		for (auto v : successors(block))
+			ret[v].push_back(id);
+	return ret;
+}
+std::vector<int> reverse_post_order(const cfg_type &cfg)
+{
+	std::vector<int> ret;
+	if (cfg.empty())
+		return ret;
+	std::set<int> visited;
+	std::vector<std::pair<int, std::vector<int>>> stack;
+	int entry = cfg.begin()->first;
+	visited.insert(entry);
+	stack.emplace_back(entry, successors(cfg.at(entry)));
+	while (!stack.empty())
+	{
+		auto &[u, succ] = stack.back();
+		if (succ.empty())
+		{
+			ret.push_back(u);
+			stack.pop_back();
+			continue;
+		}
+		int v = succ.back();
+		succ.pop_back();
+		if (visited.insert(v).second)
+			stack.emplace_back(v, successors(cfg.at(v)));
+	}
+	return std::vector<int>(ret.rbegin(), ret.rend());
+}
+std::map<int, int> gen_idom(const cfg_type &cfg)
+{
+	// Cooper, Harvey and Kennedy's iterative algorithm.
+	const auto &rpo = reverse_post_order(cfg);
+	const auto &pred = gen_predecessors(cfg);
+	std::map<int, int> order, ret;
+	for (size_t i = 0; i < rpo.size(); ++i)
+		order[rpo[i]] = i;
+	if (rpo.empty())
+		return ret;
+	ret[rpo[0]] = rpo[0];
+	for (bool changed = true; changed; )
+	{
+		changed = false;
+		for (size_t i = 1; i < rpo.size(); ++i)
+		{
+			int new_idom = END_IDX;
+			for (auto p : pred.at(rpo[i]))
+			{
+				if (ret.count(p) == 0)
+					continue;
+				if (new_idom == END_IDX)
+				{
+					new_idom = p;
+					continue;
+				}
+				int a = p, b = new_idom;
+				while (a != b)
+				{
+					while (order[a] > order[b])
+						a = ret[a];
+					while (order[b] > order[a])
+						b = ret[b];
+				}
+				new_idom = a;
+			}
+			auto it = ret.find(rpo[i]);
+			if (it == ret.end() || it->second != new_idom)
+			{
+				ret[rpo[i]] = new_idom;
+				changed = true;
+			}
+		}
+	}
+	return ret;
+}
+std::map<int, int> loop_depth(const cfg_type &cfg)
+{
+	return loop_depth(cfg, gen_idom(cfg));
+}
+std::map<int, int> loop_depth(const cfg_type &cfg,
+		const std::map<int, int> &idom)
+{
+	const auto &pred = gen_predecessors(cfg);
+	const auto &rpo = reverse_post_order(cfg);
+	std::map<int, int> order;
+	for (size_t i = 0; i < rpo.size(); ++i)
+		order[rpo[i]] = i;
+	// number the dominator tree, so h dominates u iff u's interval is in h's
+	std::map<int, std::vector<int>> children;
+	for (const auto &[u, dom] : idom)
+		if (u != dom)
+			children[dom].push_back(u);
+	std::map<int, std::pair<int, int>> interval;
+	int clock = 0;
+	if (!rpo.empty())
+	{
+		std::vector<std::pair<int, size_t>> stack{{rpo[0], 0}};
+		interval[rpo[0]].first = clock++;
+		while (!stack.empty())
+		{
+			auto &[u, next] = stack.back();
+			const auto &kids = children[u];
+			if (next == kids.size())
+			{
+				interval[u].second = clock++;
+				stack.pop_back();
+				continue;
+			}
+			int v = kids[next++];
+			interval[v].first = clock++;
+			stack.emplace_back(v, 0);
+		}
+	}
+	std::map<int, std::set<int>> body; // header -> blocks of its loop
+	for (const auto &[u, dom] : idom)
+		for (auto h : successors(cfg.at(u)))
+		{
+			// u -> h is a back edge if h dominates u, so h comes first in rpo
+			if (order.at(h) > order.at(u))
+				continue;
+			const auto &in_u = interval.at(u), &in_h = interval.at(h);
+			if (in_h.first > in_u.first || in_u.second > in_h.second)
+				continue;
+			auto &blocks = body[h];
+			blocks.insert(h);
+			std::vector<int> stack;
+			if (blocks.insert(u).second)
+				stack.push_back(u);
+			while (!stack.empty())
+			{
+				int x = stack.back();
+				stack.pop_back();
+				for (auto p : pred.at(x))
+					if (idom.count(p) != 0 && blocks.insert(p).second)
+						stack.push_back(p);
+			}
+		}
+	std::map<int, int> ret;
+	for (const auto &[u, dom] : idom)
+		ret[u] = 0;
+	for (const auto &[h, blocks] : body)
+		for (auto x : blocks)
+			++ret[x];
+	return ret;
+}
+void collect_hidden(const expr::expr &e, std::set<std::string> &out)
+{
+	const auto &type = typeid(e);
+	if (type == typeid(expr::id))
+	{
+		const auto &name = static_cast<const expr::id&>(e).id_name;
+		if (expr::is_hidden_id(name))
+			out.insert(name);
+	}
+	else if (type == typeid(expr::neg))
+		collect_hidden(*static_cast<const expr::neg&>(e).c, out);
+	else if (type != typeid(expr::imm_num))
+	{
+		collect_hidden(*static_cast<const expr::bin_op&>(e).lc, out);
+		collect_hidden(*static_cast<const expr::bin_op&>(e).rc, out);
+	}
+}
+// hidden variables read by sent, and the one it assigns ("" if none)
+std::string hidden_use_def(const statement::statement &sent,
+		std::set<std::string> &use)
+{
+	const auto &type = typeid(sent);
+	const statement::assignment *assign = nullptr;
+	if (type == typeid(statement::LET))
+		assign = &static_cast<const statement::LET&>(sent).assign;
+	else if (type == typeid(statement::END_FOR))
+		assign = &static_cast<const statement::END_FOR&>(sent).step_statement;
+	else if (type == typeid(statement::EXIT))
+		collect_hidden(*static_cast<const statement::EXIT&>(sent).val, use);
+	else if (type == typeid(statement::IF))
+		collect_hidden(*static_cast<const statement::IF&>(sent).condition, use);
+	else if (type == typeid(statement::FOR))
+		collect_hidden(*static_cast<const statement::FOR&>(sent).condition,
+				use);
+	if (assign == nullptr)
+		return "";
+	collect_hidden(*(assign->val), use);
+	std::set<std::string> def;
+	collect_hidden(*(assign->var), def);
+	return def.empty() ? "" : *def.begin();
+}
+/*
+ * Hidden variables are assigned once and read in blocks dominated by the
+ * assignment, so two of them may share a location unless one is assigned
+ * while the other is live.
+ */
+interference_map hidden_interference(const cfg_type &cfg)
+{
+	std::map<int, std::set<std::string>> live_in;
+	for (bool changed = true; changed; )
+	{
+		changed = false;
+		for (auto it = cfg.rbegin(); it != cfg.rend(); ++it)
+		{
+			std::set<std::string> live;
+			for (auto v : successors(it->second))
+				live.insert(live_in[v].begin(), live_in[v].end());
+			const auto &commands = it->second.commands;
+			for (auto sent = commands.rbegin(); sent != commands.rend(); ++sent)
+				live.erase(hidden_use_def(**sent, live));
+			if (live != live_in[it->first])
+			{
+				live_in[it->first] = std::move(live);
+				changed = true;
+			}
+		}
+	}
+	interference_map ret;
+	for (const auto &[line, block] : cfg)
+	{
+		std::set<std::string> live;
+		for (auto v : successors(block))
+			live.insert(live_in[v].begin(), live_in[v].end());
+		for (auto sent = block.commands.rbegin();
+				sent != block.commands.rend(); ++sent)
+		{
+			std::set<std::string> use;
+			auto def = hidden_use_def(**sent, use);
+			if (!def.empty())
+			{
+				ret[def];
+				for (const auto &v : live)
+					if (v != def)
+					{
+						ret[def].insert(v);
+						ret[v].insert(def);
+					}
+				live.erase(def);
+			}
+			live.insert(use.begin(), use.end());
+		}
+	}
+	return ret;
+}
 }
@@ -1,6 +1,10 @@
 #ifndef BASIC_BLOCK_HPP
 #define BASIC_BLOCK_HPP
 #include "statement.hpp"
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
 namespace basic_block
 {
 using statement::program_type;
@@ -16,7 +20,22 @@ struct basic_block_type
 };
 const int BEGIN_IDX = -1, END_IDX = -2;
 using cfg_type = std::map<int, basic_block_type>;
-cfg_type gen_cfg(const program_type &prog);
+// warnings about unreachable code go to log
+cfg_type gen_cfg(const program_type &prog, std::ostream &log = std::clog);
+// the same, taking the statements out of prog as their blocks are built
+cfg_type gen_cfg(program_type &&prog, std::ostream &log = std::clog);
 void print_cfg(std::ostream &os, const cfg_type &cfg);
+std::vector<int> successors(const basic_block_type &block);
+std::map<int, std::vector<int>> gen_predecessors(const cfg_type &cfg);
+std::vector<int> reverse_post_order(const cfg_type &cfg);
+std::map<int, int> gen_idom(const cfg_type &cfg); // idom of entry is itself
+// how many natural loops contain each reachable block
+std::map<int, int> loop_depth(const cfg_type &cfg);
+// the same, given gen_idom(cfg)
+std::map<int, int> loop_depth(const cfg_type &cfg,
+		const std::map<int, int> &idom);
+// for each hidden variable ($1, $2...), those it cannot share a location with
+using interference_map = std::map<std::string, std::set<std::string>>;
+interference_map hidden_interference(const cfg_type &cfg);
 }
 #endif
@@ -0,0 +1,262 @@
+#include "cache.hpp"
+#include "isa.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+namespace cache
+{
+using namespace inst;
+namespace fs = std::filesystem;
+const size_t MAX_PACKS = 16;
+const char PACK_SUFFIX[] = ".pack";
+const char PACK_MAGIC[8] = {'B', 'C', 'P', 'A', 'C', 'K', 0, 3};
+enum record : uint32_t { BLOCK_RECORD, PROGRAM_RECORD };
+uint64_t mix(uint64_t x)
+{
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccd;
+	x ^= x >> 33;
+	x *= 0xc4ceb9fe1a85ec53;
+	return x ^ x >> 33;
+}
+void digest::add(const void *data, size_t len)
+{
+	auto p = static_cast<const unsigned char *>(data);
+	for (size_t i = 0; i < len; ++i)
+	{
+		a = (a ^ p[i]) * 0x100000001b3;
+		b = (b + p[i]) * 0x9e3779b97f4a7c15;
+		b ^= b >> 29;
+	}
+}
+key digest::value() const
+{
+	return {mix(a), mix(b ^ a)};
+}
+/*
+ * Packs hold instructions as raw structs, so they are only read back by a
+ * compiler with the same struct layout and the same inst_op numbering; this
+ * digest of both follows any change to either.
+ */
+key format_key()
+{
+	digest h;
+	h.add(sizeof(instruction));
+	for (size_t offset : {offsetof(instruction, op), offsetof(instruction, rs1),
+			offsetof(instruction, rs2), offsetof(instruction, imm),
+			offsetof(instruction, rd)})
+		h.add(offset);
+	h.add(std::size(isa::table));
+	for (const auto &d : isa::table)
+	{
+		h.add(d.name);
+		h.add(int64_t(d.fmt));
+		h.add(int64_t(d.opcode));
+		h.add(d.funct3);
+		h.add(d.funct7);
+	}
+	return h.value();
+}
+std::optional<key> compiler_id()
+{
+	static const auto id = []() -> std::optional<key>
+	{
+		std::ifstream is("/proc/self/exe", std::ios::binary);
+		std::string data((std::istreambuf_iterator<char>(is)),
+				std::istreambuf_iterator<char>());
+		if (data.empty())
+			return std::nullopt;
+		digest h;
+		h.add(data);
+		return h.value();
+	}();
+	return id;
+}
+struct reader
+{
+	const std::string &data;
+	size_t pos = 0;
+	bool get(void *out, size_t len)
+	{
+		if (pos + len > data.size())
+			return false;
+		std::memcpy(out, data.data() + pos, len);
+		pos += len;
+		return true;
+	}
+	bool get(std::string &out)
+	{
+		uint32_t len;
+		if (!get(&len, 4) || len > data.size() - pos)
+			return false;
+		out.assign(data, pos, len);
+		pos += len;
+		return true;
+	}
+};
+void put(std::string &out, const void *in, size_t len)
+{
+	out.append(static_cast<const char *>(in), len);
+}
+void put(std::string &out, const std::string &in)
+{
+	uint32_t len = in.size();
+	put(out, &len, 4);
+	out += in;
+}
+store::store(const std::string &_dir) : dir(_dir), format(format_key())
+{
+	std::error_code ec;
+	fs::create_directories(dir, ec);
+	if (!fs::is_directory(dir, ec))
+		throw "Cannot create cache directory.";
+	std::vector<std::string> packs;
+	for (const auto &file : fs::directory_iterator(dir, ec))
+		if (file.path().extension() == PACK_SUFFIX)
+			packs.push_back(file.path().string());
+	for (const auto &path : packs)
+		read_pack(path);
+	if (packs.size() > MAX_PACKS)
+	{
+		std::vector<key> keys, program_keys;
+		for (const auto &[k, e] : entries)
+			keys.push_back(k);
+		for (const auto &[k, p] : programs)
+			program_keys.push_back(k);
+		write_pack(keys, program_keys);
+		for (const auto &path : packs)
+			fs::remove(path, ec);
+	}
+}
+store::~store()
+{
+	flush();
+}
+// a pack is the magic and the format key, then a sequence of records: the
+// kind and the key, then the slot end, a count and the instructions of a
+// block, or the output and the log of a program, each with its length
+void store::read_pack(const std::string &path)
+{
+	std::ifstream is(path, std::ios::binary);
+	std::string data((std::istreambuf_iterator<char>(is)),
+			std::istreambuf_iterator<char>());
+	reader in{data};
+	char magic[sizeof(PACK_MAGIC)];
+	key k;
+	if (!in.get(magic, sizeof(magic))
+			|| std::memcmp(magic, PACK_MAGIC, sizeof(magic)) != 0
+			|| !in.get(&k.first, 8) || !in.get(&k.second, 8)
+			|| k != format)
+		return;
+	for (uint32_t kind, n; in.get(&kind, 4) && in.get(&k.first, 8)
+			&& in.get(&k.second, 8); )
+	{
+		if (kind == PROGRAM_RECORD)
+		{
+			program p;
+			if (!in.get(p.output) || !in.get(p.log))
+				return;
+			programs.emplace(k, std::move(p));
+			continue;
+		}
+		entry e;
+		if (kind != BLOCK_RECORD || !in.get(&e.slot_end, 4) || !in.get(&n, 4)
+				|| n > (data.size() - in.pos) / sizeof(instruction))
+			return;
+		e.code.resize(n);
+		in.get(e.code.data(), n * sizeof(instruction));
+		entries.emplace(k, std::move(e));
+	}
+}
+void store::write_pack(const std::vector<key> &keys,
+		const std::vector<key> &program_keys) const
+{
+	std::string data(PACK_MAGIC, sizeof(PACK_MAGIC));
+	put(data, &format.first, 8);
+	put(data, &format.second, 8);
+	for (const auto &k : program_keys)
+	{
+		const auto &p = programs.at(k);
+		uint32_t kind = PROGRAM_RECORD;
+		put(data, &kind, 4);
+		put(data, &k.first, 8);
+		put(data, &k.second, 8);
+		put(data, p.output);
+		put(data, p.log);
+	}
+	for (const auto &k : keys)
+	{
+		const auto &e = entries.at(k);
+		uint32_t kind = BLOCK_RECORD, n = e.code.size();
+		put(data, &kind, 4);
+		put(data, &k.first, 8);
+		put(data, &k.second, 8);
+		put(data, &e.slot_end, 4);
+		put(data, &n, 4);
+		put(data, e.code.data(), n * sizeof(instruction));
+	}
+	std::ostringstream name;
+	name << dir << '/' << std::hex << std::random_device()()
+		<< std::random_device()();
+	auto tmp = name.str() + ".tmp";
+	{
+		std::ofstream os(tmp, std::ios::binary);
+		os.write(data.data(), data.size());
+		if (!os)
+			return;
+	}
+	std::error_code ec;
+	fs::rename(tmp, name.str() + PACK_SUFFIX, ec);
+	if (ec)
+		fs::remove(tmp, ec);
+}
+bool store::load(const key &k, std::vector<instruction> &code,
+		int &slot_end) const
+{
+	std::lock_guard<std::mutex> guard(lock);
+	auto it = entries.find(k);
+	if (it == entries.end())
+		return false;
+	code = it->second.code;
+	slot_end = it->second.slot_end;
+	return true;
+}
+void store::save(const key &k, const std::vector<instruction> &code,
+		int slot_end)
+{
+	std::lock_guard<std::mutex> guard(lock);
+	if (entries.emplace(k, entry{code, slot_end}).second)
+		fresh.push_back(k);
+}
+bool store::load_output(const key &k, std::string &output,
+		std::string &log) const
+{
+	std::lock_guard<std::mutex> guard(lock);
+	auto it = programs.find(k);
+	if (it == programs.end())
+		return false;
+	output = it->second.output;
+	log = it->second.log;
+	return true;
+}
+void store::save_output(const key &k, const std::string &output,
+		const std::string &log)
+{
+	std::lock_guard<std::mutex> guard(lock);
+	if (programs.emplace(k, program{output, log}).second)
+		fresh_programs.push_back(k);
+}
+void store::flush()
+{
+	std::lock_guard<std::mutex> guard(lock);
+	if (fresh.empty() && fresh_programs.empty())
+		return;
+	write_pack(fresh, fresh_programs);
+	fresh.clear();
+	fresh_programs.clear();
+}
+}
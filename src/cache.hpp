@@ -0,0 +1,85 @@
+#ifndef CACHE_HPP
+#define CACHE_HPP
+#include "inst.hpp"
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+namespace cache
+{
+using key = std::pair<uint64_t, uint64_t>;
+// Two independent 64-bit hashes, wide enough to stand for the content itself
+// as long as it is added in a form that reads back one way only: tag each
+// kind of node and give each list its length.
+class digest
+{
+	uint64_t a = 0xcbf29ce484222325, b = 0x9e3779b97f4a7c15;
+public:
+	void add(const void *data, size_t len);
+	void add(int64_t x)
+	{
+		add(&x, sizeof(x));
+	}
+	void add(const std::string &s)
+	{
+		add(int64_t(s.size()));
+		add(s.data(), s.size());
+	}
+	key value() const;
+};
+// a digest of the running executable, if it can be read
+std::optional<key> compiler_id();
+/*
+ * Translated blocks and the output of whole compiles, kept in a directory of
+ * pack files and looked up by digest.  All packs are read when the store is
+ * opened, and entries saved since are written as one new pack by flush or
+ * the destructor; packs are written under a temporary name and renamed, so
+ * concurrent compilers may share a directory.  Once there are many packs
+ * they are merged into one.
+ */
+class store
+{
+	struct entry
+	{
+		std::vector<inst::instruction> code;
+		int slot_end;
+	};
+	struct program
+	{
+		std::string output, log;
+	};
+	struct key_hash
+	{
+		size_t operator() (const key &k) const
+		{
+			return k.first ^ k.second;
+		}
+	};
+	std::string dir;
+	key format; // of the instructions in packs
+	mutable std::mutex lock;
+	std::unordered_map<key, entry, key_hash> entries;
+	std::unordered_map<key, program, key_hash> programs;
+	// keys saved since the last flush
+	std::vector<key> fresh, fresh_programs;
+	void read_pack(const std::string &path);
+	void write_pack(const std::vector<key> &keys,
+			const std::vector<key> &program_keys) const;
+public:
+	explicit store(const std::string &_dir);
+	~store();
+	bool load(const key &k, std::vector<inst::instruction> &code,
+			int &slot_end) const;
+	void save(const key &k, const std::vector<inst::instruction> &code,
+			int slot_end);
+	bool load_output(const key &k, std::string &output,
+			std::string &log) const;
+	void save_output(const key &k, const std::string &output,
+			const std::string &log);
+	void flush();
+};
+}
+#endif
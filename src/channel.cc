@@ -0,0 +1,166 @@
+#include "channel.hpp"
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+namespace channel
+{
+const uint32_t MAX_FRAME = 64 << 20;
+sockaddr_un address(const std::string &path)
+{
+	sockaddr_un addr{};
+	addr.sun_family = AF_UNIX;
+	if (path.size() >= sizeof(addr.sun_path))
+		throw "Socket path too long.";
+	std::strcpy(addr.sun_path, path.c_str());
+	return addr;
+}
+connection::~connection()
+{
+	if (fd >= 0)
+		close(fd);
+}
+void connection::set_timeout(std::chrono::milliseconds time)
+{
+	timed = true;
+	deadline = std::chrono::steady_clock::now() + time;
+}
+// false if the deadline passes before fd is ready for events
+bool connection::wait(short events) const
+{
+	if (!timed)
+		return true;
+	for (;;)
+	{
+		auto left = std::chrono::duration_cast<std::chrono::milliseconds>
+			(deadline - std::chrono::steady_clock::now()).count();
+		if (left <= 0)
+			return false;
+		pollfd p{fd, events, 0};
+		int n = poll(&p, 1, left);
+		if (n > 0)
+			return true;
+		if (n < 0 && errno != EINTR)
+			return false;
+	}
+}
+bool connection::send_all(const char *data, size_t len)
+{
+	int flags = MSG_NOSIGNAL | (timed ? MSG_DONTWAIT : 0);
+	while (len > 0)
+	{
+		if (!wait(POLLOUT))
+			return false;
+		ssize_t n = send(fd, data, len, flags);
+		if (n < 0 && (errno == EINTR || errno == EAGAIN))
+			continue;
+		if (n <= 0)
+			return false;
+		data += n;
+		len -= n;
+	}
+	return true;
+}
+bool connection::recv_all(char *data, size_t len)
+{
+	int flags = timed ? MSG_DONTWAIT : 0;
+	while (len > 0)
+	{
+		if (!wait(POLLIN))
+			return false;
+		ssize_t n = recv(fd, data, len, flags);
+		if (n < 0 && (errno == EINTR || errno == EAGAIN))
+			continue;
+		if (n <= 0)
+			return false;
+		data += n;
+		len -= n;
+	}
+	return true;
+}
+bool connection::send_frame(const std::string &data)
+{
+	uint32_t len = data.size();
+	return send_all(reinterpret_cast<const char *>(&len), 4)
+		&& send_all(data.data(), len);
+}
+bool connection::recv_frame(std::string &data)
+{
+	uint32_t len;
+	if (!recv_all(reinterpret_cast<char *>(&len), 4) || len > MAX_FRAME)
+		return false;
+	data.resize(len);
+	return recv_all(data.data(), len);
+}
+// true if the socket at addr is left over from a server that is gone
+bool stale(const sockaddr_un &addr)
+{
+	int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (probe < 0)
+		return false;
+	bool refused = ::connect(probe, reinterpret_cast<const sockaddr *>(&addr),
+			sizeof(addr)) != 0 && errno == ECONNREFUSED;
+	close(probe);
+	return refused;
+}
+listener::listener(const std::string &_path) : path(_path)
+{
+	auto addr = address(path);
+	// only a dead server's socket is replaced, never another file
+	struct stat st;
+	if (lstat(path.c_str(), &st) == 0)
+	{
+		if (!S_ISSOCK(st.st_mode))
+			throw "Socket path is taken by another file.";
+		if (!stale(addr))
+			throw "Socket is in use by a running server.";
+		unlink(path.c_str());
+	}
+	else if (errno != ENOENT)
+		throw "Cannot listen on socket.";
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+		throw "Cannot create socket.";
+	if (bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0
+			|| listen(fd, 64) != 0)
+	{
+		close(fd);
+		throw "Cannot listen on socket.";
+	}
+}
+listener::~listener()
+{
+	close(fd);
+	unlink(path.c_str());
+}
+int listener::accept()
+{
+	for (;;)
+	{
+		int conn = ::accept(fd, nullptr, nullptr);
+		if (conn >= 0 || (errno != EINTR && errno != ECONNABORTED))
+			return conn;
+	}
+}
+void listener::shutdown()
+{
+	::shutdown(fd, SHUT_RDWR);
+}
+int connect(const std::string &path)
+{
+	auto addr = address(path);
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+		throw "Cannot connect to server.";
+	if (::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0)
+	{
+		close(fd);
+		throw "Cannot connect to server.";
+	}
+	return fd;
+}
+}
@@ -0,0 +1,46 @@
+#ifndef CHANNEL_HPP
+#define CHANNEL_HPP
+#include <chrono>
+#include <string>
+namespace channel
+{
+// A stream on a UNIX socket, carrying frames: a 32-bit length in host order
+// and that many bytes.
+class connection
+{
+	int fd;
+	bool timed = false;
+	std::chrono::steady_clock::time_point deadline;
+	bool wait(short events) const;
+	bool send_all(const char *data, size_t len);
+	bool recv_all(char *data, size_t len);
+public:
+	explicit connection(int _fd) : fd(_fd) {}
+	connection(const connection &) = delete;
+	~connection();
+	// sends and receives fail once time has passed from now, so a peer that
+	// stalls cannot hold the connection; without a call they wait forever
+	void set_timeout(std::chrono::milliseconds time);
+	bool send_frame(const std::string &data);
+	bool recv_frame(std::string &data);
+};
+// Listens on the socket at path, which it removes again when destroyed.  A
+// socket already at path is replaced only if no server accepts on it; any
+// other file there makes the constructor throw.
+class listener
+{
+	int fd;
+	std::string path;
+public:
+	explicit listener(const std::string &_path);
+	listener(const listener &) = delete;
+	~listener();
+	// the socket of the next client, or -1 once shut down
+	int accept();
+	// makes every accept, also those blocked in other threads, return -1
+	void shutdown();
+};
+// the socket of a new connection to path
+int connect(const std::string &path);
+}
+#endif
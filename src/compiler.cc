@@ -1,15 +1,141 @@
-#include "to_raw.hpp"
+#include "driver.hpp"
+#include "interp.hpp"
+#include "jit.hpp"
+#include "pool.hpp"
+#include "server.hpp"
+#include <algorithm>
+#include <fstream>
 #include <iostream>
-int main()
+#include <memory>
+#include <string>
+int main(int argc, char **argv)
 {
+	driver::settings s;
+	auto &opt = s.opt;
+	opt.jobs = pool::default_threads();
+	profile::counts prof;
+	std::string elf_file, batch, serve, connect, forwarded;
+	std::unique_ptr<cache::store> block_cache;
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg(argv[i]);
+		if (driver::parse_option(arg, s))
+			forwarded += ' ' + arg;
+		else if (arg.rfind("--jobs=", 0) == 0)
+		{
+			long jobs;
+			if (!driver::parse_count(arg.substr(arg.find('=') + 1), jobs)
+					|| jobs == 0)
+			{
+				std::cerr << "Unknown option " << arg << std::endl;
+				return 1;
+			}
+			opt.jobs = std::min<long>(jobs, pool::MAX_THREADS);
+		}
+		else if (arg.rfind("--run=", 0) == 0 || arg.rfind("--jit=", 0) == 0)
+		{
+			// run the program in FILE on the input from stdin
+			std::ifstream is(arg.substr(arg.find('=') + 1));
+			if (!is)
+			{
+				std::cerr << "Cannot open " << arg << std::endl;
+				return 1;
+			}
+			try
+			{
+				auto &&prog = statement::read_program(is);
+				auto &&arrays = array::lower(prog);
+				if (arg[2] == 'r')
+					std::cout << interp::run(interp::compile(prog, arrays),
+							std::cin) << std::endl;
+				else
+					std::cout << jit::compile(basic_block::gen_cfg(prog),
+							arrays).run(std::cin) << std::endl;
+			}
+			catch (const char *e)
+			{
+				std::cerr << e << std::endl;
+				return 1;
+			}
+			return 0;
+		}
+		else if (arg.rfind("--elf=", 0) == 0)
+			elf_file = arg.substr(arg.find('=') + 1);
+		else if (arg.rfind("--batch=", 0) == 0)
+			batch = arg.substr(arg.find('=') + 1);
+		else if (arg.rfind("--serve=", 0) == 0)
+			serve = arg.substr(arg.find('=') + 1);
+		else if (arg.rfind("--connect=", 0) == 0)
+			connect = arg.substr(arg.find('=') + 1);
+		else if (arg == "--stop-server")
+			forwarded += ' ' + arg;
+		else if (arg.rfind("--cache=", 0) == 0)
+		{
+			try
+			{
+				block_cache = std::make_unique<cache::store>
+					(arg.substr(arg.find('=') + 1));
+			}
+			catch (const char *e)
+			{
+				std::cerr << e << std::endl;
+				return 1;
+			}
+			opt.cache = block_cache.get();
+		}
+		else if (arg == "--instrument")
+			opt.instrument = true;
+		else if (arg.rfind("--profile=", 0) == 0)
+		{
+			std::ifstream is(arg.substr(arg.find('=') + 1));
+			if (!is)
+			{
+				std::cerr << "Cannot open profile " << arg << std::endl;
+				return 1;
+			}
+			prof = profile::read_counts(is);
+			opt.prof = &prof;
+		}
+		else
+		{
+			std::cerr << "Unknown option " << arg << std::endl;
+			return 1;
+		}
+	}
 	try
 	{
-		auto &&prog = statement::read_program(std::cin);
-		auto &&cfg = basic_block::gen_cfg(prog);
-		auto &&obj_code = translate::translate_to_obj_code(cfg);
-		auto &&linked_code = link::link(obj_code);
-		auto &&raw_prog = to_raw::to_raw_prog(linked_code);
-		to_raw::print_raw_prog(std::cout, raw_prog);
+		if (!connect.empty() && elf_file.empty())
+			return !server::request(connect, forwarded, std::cin, std::cout,
+					std::cerr);
+		if (!connect.empty())
+		{
+			std::ofstream os(elf_file, std::ios::binary);
+			if (!os)
+				throw "Cannot open ELF output file";
+			return !server::request(connect, forwarded + " --elf", std::cin,
+					os, std::cerr);
+		}
+		// programs run side by side, so each is translated serially
+		unsigned threads = opt.jobs;
+		if (!batch.empty() || !serve.empty())
+			opt.jobs = 1;
+		if (!batch.empty())
+			return driver::compile_batch(batch, s, threads, std::cout) != 0;
+		if (!serve.empty())
+		{
+			server::serve(serve, s, threads);
+			return 0;
+		}
+		if (elf_file.empty())
+			driver::compile(std::cin, std::cout, std::clog, s);
+		else
+		{
+			std::ofstream os(elf_file, std::ios::binary);
+			if (!os)
+				throw "Cannot open ELF output file";
+			s.elf = true;
+			driver::compile(std::cin, os, std::clog, s);
+		}
 	}
 	catch (const char *e)
 	{
@@ -0,0 +1,229 @@
+#include "dead_store.hpp"
+#include <cstdint>
+#include <typeinfo>
+#include <unordered_map>
+#include <vector>
+namespace dead_store
+{
+using basic_block::cfg_type;
+class var_set
+{
+	std::vector<uint64_t> words;
+public:
+	explicit var_set(size_t n = 0) : words((n + 63) / 64) {}
+	bool test(int v) const
+	{
+		return words[v / 64] >> (v % 64) & 1;
+	}
+	void set(int v)
+	{
+		words[v / 64] |= uint64_t(1) << (v % 64);
+	}
+	void reset(int v)
+	{
+		words[v / 64] &= ~(uint64_t(1) << (v % 64));
+	}
+	void merge(const var_set &other)
+	{
+		for (size_t i = 0; i < words.size(); ++i)
+			words[i] |= other.words[i];
+	}
+	bool operator== (const var_set &other) const
+	{
+		return words == other.words;
+	}
+};
+// what one statement (or one variable of an INPUT) does to variables
+struct step
+{
+	size_t command; // index in the block, the condition if past the end
+	int def; // -1 if none
+	bool removable; // a plain assignment
+	std::vector<int> uses;
+};
+struct analysis
+{
+	std::unordered_map<std::string, int> index;
+	std::vector<std::string> names;
+	int var(const std::string &name)
+	{
+		auto &&[it, inserted] = index.emplace(name, names.size());
+		if (inserted)
+			names.push_back(name);
+		return it->second;
+	}
+	void collect(const expr::expr &e, std::vector<int> &out)
+	{
+		const auto &type = typeid(e);
+		if (type == typeid(expr::id))
+			out.push_back(var(static_cast<const expr::id&>(e).id_name));
+		else if (type == typeid(expr::neg))
+			collect(*static_cast<const expr::neg&>(e).c, out);
+		else if (type == typeid(expr::subscript)) // arrays are not variables
+			collect(*static_cast<const expr::subscript&>(e).rc, out);
+		else if (type != typeid(expr::imm_num))
+		{
+			collect(*static_cast<const expr::bin_op&>(e).lc, out);
+			collect(*static_cast<const expr::bin_op&>(e).rc, out);
+		}
+	}
+	// stores var, read after the value
+	void store(const expr::expr &var, size_t cmd, bool plain, step &s)
+	{
+		s.command = cmd;
+		s.def = -1;
+		s.removable = false;
+		if (typeid(var) == typeid(expr::id))
+		{
+			s.def = this->var(static_cast<const expr::id&>(var).id_name);
+			s.removable = plain;
+		}
+		else
+			collect(var, s.uses);
+	}
+	std::vector<step> steps(const basic_block::basic_block_type &block)
+	{
+		std::vector<step> ret;
+		for (size_t i = 0; i < block.commands.size(); ++i)
+		{
+			const auto &sent = *block.commands[i];
+			const auto &type = typeid(sent);
+			const statement::assignment *assign = nullptr;
+			if (type == typeid(statement::LET))
+				assign = &static_cast<const statement::LET&>(sent).assign;
+			else if (type == typeid(statement::END_FOR))
+				assign = &static_cast<const statement::END_FOR&>(sent)
+					.step_statement;
+			if (assign != nullptr)
+			{
+				ret.emplace_back();
+				store(*assign->var, i, true, ret.back());
+				collect(*assign->val, ret.back().uses);
+			}
+			else if (type == typeid(statement::INPUT))
+				for (const auto &var :
+						static_cast<const statement::INPUT&>(sent).inputs)
+				{
+					ret.emplace_back();
+					store(*var, i, false, ret.back());
+				}
+			else
+			{
+				ret.push_back(step{i, -1, false, {}});
+				if (type == typeid(statement::EXIT))
+					collect(*static_cast<const statement::EXIT&>(sent).val,
+							ret.back().uses);
+				else if (type == typeid(statement::IF))
+					collect(*static_cast<const statement::IF&>(sent)
+							.condition, ret.back().uses);
+				else if (type == typeid(statement::FOR))
+					collect(*static_cast<const statement::FOR&>(sent)
+							.condition, ret.back().uses);
+			}
+		}
+		if (block.condition != nullptr)
+		{
+			ret.push_back(step{block.commands.size(), -1, false, {}});
+			collect(*block.condition, ret.back().uses);
+		}
+		return ret;
+	}
+};
+// live turns from the variables live after the steps to those live before;
+// dead gets the steps that can go
+void transfer(const std::vector<step> &steps, var_set &live,
+		std::vector<bool> *dead = nullptr)
+{
+	for (size_t i = steps.size(); i-- > 0; )
+	{
+		const auto &s = steps[i];
+		if (s.removable && !live.test(s.def))
+		{
+			if (dead != nullptr)
+				(*dead)[i] = true;
+			continue;
+		}
+		if (s.def != -1)
+			live.reset(s.def);
+		for (int v : s.uses)
+			live.set(v);
+	}
+}
+void eliminate(cfg_type &cfg)
+{
+	if (cfg.empty())
+		return;
+	analysis a;
+	std::vector<int> ids;
+	std::unordered_map<int, size_t> pos;
+	std::vector<std::vector<step>> steps;
+	for (const auto &[id, block] : cfg)
+	{
+		pos[id] = ids.size();
+		ids.push_back(id);
+		steps.push_back(a.steps(block));
+	}
+	size_t n = a.names.size();
+	std::vector<std::vector<size_t>> succ(ids.size());
+	for (size_t b = 0; b < ids.size(); ++b)
+		for (int v : basic_block::successors(cfg.at(ids[b])))
+			succ[b].push_back(pos.at(v));
+	std::vector<var_set> live_in(ids.size(), var_set(n));
+	for (bool changed = true; changed; )
+	{
+		changed = false;
+		for (size_t b = ids.size(); b-- > 0; )
+		{
+			var_set live(n);
+			for (auto v : succ[b])
+				live.merge(live_in[v]);
+			transfer(steps[b], live);
+			if (!(live == live_in[b]))
+			{
+				live_in[b] = std::move(live);
+				changed = true;
+			}
+		}
+	}
+	std::vector<bool> assigned(n), kept(n), read(n);
+	for (size_t b = 0; b < ids.size(); ++b)
+	{
+		var_set live(n);
+		for (auto v : succ[b])
+			live.merge(live_in[v]);
+		std::vector<bool> dead(steps[b].size());
+		transfer(steps[b], live, &dead);
+		auto &commands = cfg.at(ids[b]).commands;
+		std::vector<bool> drop(commands.size());
+		for (size_t i = 0; i < steps[b].size(); ++i)
+		{
+			const auto &s = steps[b][i];
+			if (s.def != -1)
+			{
+				assigned[s.def] = true;
+				if (!dead[i])
+					kept[s.def] = true;
+			}
+			if (dead[i])
+				drop[s.command] = true;
+			else
+				for (int v : s.uses)
+					read[v] = true;
+		}
+		size_t j = 0;
+		for (size_t i = 0; i < commands.size(); ++i)
+			if (!drop[i])
+				commands[j++] = std::move(commands[i]);
+		commands.resize(j);
+	}
+	std::vector<std::unique_ptr<statement::statement>> init;
+	for (size_t v = 0; v < n; ++v)
+		if (read[v] && assigned[v] && !kept[v])
+			init.push_back(std::make_unique<statement::LET>
+				(statement::assignment(std::make_unique<expr::id>(a.names[v]),
+					std::make_unique<expr::imm_num>(0))));
+	auto &entry = cfg.begin()->second.commands;
+	entry.insert(entry.begin(), std::make_move_iterator(init.begin()),
+			std::make_move_iterator(init.end()));
+}
+}
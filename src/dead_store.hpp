@@ -0,0 +1,16 @@
+#ifndef DEAD_STORE_HPP
+#define DEAD_STORE_HPP
+#include "basic_block.hpp"
+namespace dead_store
+{
+/*
+ * Removes every LET and END_FOR assigning a variable that no later statement
+ * or branch reads on any path, counting only reads by statements that are
+ * kept themselves; a variable left with no assignment then gets no slot.
+ * INPUT and stores into arrays are always kept.  A variable still read (before
+ * any assignment, or only by unreachable blocks) that loses all its
+ * assignments is set to 0 on entry, the value its slot would have held.
+ */
+void eliminate(basic_block::cfg_type &cfg);
+}
+#endif
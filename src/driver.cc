@@ -0,0 +1,260 @@
+#include "driver.hpp"
+#include "elf.hpp"
+#include "pool.hpp"
+#include "rvc.hpp"
+#include "to_raw.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <vector>
+namespace driver
+{
+namespace fs = std::filesystem;
+using steady = std::chrono::steady_clock;
+bool parse_count(const std::string &text, long &value)
+{
+	if (text.empty() || !std::isdigit(static_cast<unsigned char>(text[0])))
+		return false;
+	char *end;
+	errno = 0;
+	long n = std::strtol(text.c_str(), &end, 10);
+	if (*end != '\0' || errno != 0)
+		return false;
+	value = n;
+	return true;
+}
+bool parse_option(const std::string &arg, settings &s)
+{
+	if (arg == "--peephole-stats")
+		s.peephole_stats = true;
+	else if (arg.rfind("--pe-budget=", 0) == 0)
+		return parse_count(arg.substr(arg.find('=') + 1), s.passes.pe_budget);
+	else if (arg == "--rvc")
+		s.compressed = true;
+	else if (arg == "--elf")
+		s.elf = true;
+	else
+		return pass::parse_option(arg, s.passes);
+	return true;
+}
+// every stage frees its input as it consumes it
+void run_stages(std::istream &is, std::ostream &os, std::ostream &log,
+		const settings &s)
+{
+	auto &&prog = statement::read_program(is);
+	auto &&arrays = array::lower(prog);
+	auto &&cfg = basic_block::gen_cfg(std::move(prog), log);
+	pass::manager passes(s.passes, log);
+	passes.run_cfg(cfg);
+	auto opt = s.opt;
+	opt.arrays = &arrays;
+	passes.prepare_layout(cfg, opt);
+	bool per_block = passes.per_block();
+	if (per_block)
+		opt.finish_block = [&passes](std::vector<inst::instruction> &code,
+				bool branch)
+		{
+			passes.run_block(code, branch);
+		};
+	auto &&obj_code = translate::translate_to_obj_code(std::move(cfg), opt);
+	if (!per_block)
+		passes.run_code(obj_code);
+	link::symbol_table symbols;
+	int slots = obj_code.slots;
+	auto &&linked_code = link::link(std::move(obj_code), s.opt.prof,
+			&symbols);
+	passes.run_linked(linked_code, symbols);
+	if (s.compressed)
+	{
+		auto &&raw = rvc::assemble(linked_code, &symbols);
+		link::check_size(raw.size(), slots);
+		if (s.elf)
+			elf::write_elf(os, raw, symbols, true);
+		else
+			to_raw::write_hex(os, raw);
+	}
+	else
+	{
+		link::check_size(4 * linked_code.size(), slots);
+		if (s.elf)
+			elf::write_elf(os, to_raw::to_raw_prog(linked_code), symbols,
+					false);
+		else
+			to_raw::write_hex(os, linked_code);
+	}
+	if (s.peephole_stats)
+		peephole::print_stats(log, passes.stats);
+}
+// the source and every setting that changes the output or the log
+cache::key program_key(const std::string &source, const settings &s,
+		const cache::key &compiler)
+{
+	cache::digest h;
+	h.add(compiler.first);
+	h.add(compiler.second);
+	h.add(source);
+	const auto &p = s.passes;
+	h.add(int64_t(p.opt_level));
+	h.add(p.pe_budget);
+	for (const auto *names : {&p.disabled, &p.print_after})
+	{
+		h.add(names->size());
+		for (const auto &name : *names)
+			h.add(name);
+	}
+	h.add(p.verify);
+	h.add(s.opt.instrument);
+	h.add(s.opt.prof != nullptr);
+	if (s.opt.prof != nullptr)
+	{
+		h.add(s.opt.prof->size());
+		for (const auto &[id, count] : *s.opt.prof)
+		{
+			h.add(id);
+			h.add(count);
+		}
+	}
+	h.add(s.compressed);
+	h.add(s.elf);
+	h.add(s.peephole_stats);
+	return h.value();
+}
+void compile(std::istream &is, std::ostream &os, std::ostream &log,
+		const settings &s)
+{
+	auto id = cache::compiler_id();
+	if (s.opt.cache == nullptr || !id)
+	{
+		run_stages(is, os, log, s);
+		return;
+	}
+	// a program compiled before skips every stage
+	std::string source((std::istreambuf_iterator<char>(is)),
+			std::istreambuf_iterator<char>());
+	auto &&key = program_key(source, s, *id);
+	std::string output, warnings;
+	if (!s.opt.cache->load_output(key, output, warnings))
+	{
+		std::istringstream src(source);
+		std::ostringstream out, lg;
+		try
+		{
+			run_stages(src, out, lg, s);
+		}
+		catch (...)
+		{
+			log << lg.str();
+			throw;
+		}
+		output = out.str();
+		warnings = lg.str();
+		s.opt.cache->save_output(key, output, warnings);
+	}
+	os.write(output.data(), output.size());
+	log << warnings;
+}
+std::vector<std::string> list_sources(const std::string &path)
+{
+	std::vector<std::string> ret;
+	std::error_code ec;
+	if (fs::is_directory(path, ec))
+	{
+		for (const auto &file : fs::directory_iterator(path, ec))
+			if (file.path().extension() == ".bas")
+				ret.push_back(file.path().string());
+		std::sort(ret.begin(), ret.end());
+		return ret;
+	}
+	std::ifstream is(path);
+	if (!is)
+		throw "Cannot open batch manifest.";
+	for (std::string line; std::getline(is, line); )
+		if (!line.empty())
+			ret.push_back(line);
+	return ret;
+}
+struct result
+{
+	std::string error; // empty on success
+	double ms = 0;
+};
+// the output buffer of a worker, kept between its programs
+thread_local std::ostringstream output;
+result compile_one(const std::string &source, const settings &s)
+{
+	result ret;
+	auto start = steady::now();
+	std::ostringstream log;
+	output.str("");
+	auto target = fs::path(source).replace_extension(s.elf ? ".elf" : ".hex");
+	try
+	{
+		std::ifstream is(source);
+		if (!is)
+			throw "Cannot open source file.";
+		compile(is, output, log, s);
+		std::ofstream os(target, std::ios::binary);
+		auto &&data = output.str();
+		if (!os.write(data.data(), data.size()))
+			throw "Cannot write output file.";
+	}
+	catch (const char *e)
+	{
+		ret.error = e;
+	}
+	catch (const std::exception &e)
+	{
+		ret.error = e.what();
+	}
+	std::error_code ec;
+	if (!ret.error.empty())
+	{
+		log << ret.error << '\n';
+		fs::remove(target, ec);
+	}
+	auto log_file = fs::path(source).replace_extension(".log");
+	if (log.tellp() > 0)
+		std::ofstream(log_file) << log.str();
+	else
+		fs::remove(log_file, ec);
+	ret.ms = std::chrono::duration<double, std::milli>
+		(steady::now() - start).count();
+	return ret;
+}
+size_t compile_batch(const std::string &path, const settings &s,
+		unsigned threads, std::ostream &report)
+{
+	auto start = steady::now();
+	auto &&sources = list_sources(path);
+	std::vector<result> results(sources.size());
+	pool::for_each(sources.size(), [&](size_t i)
+	{
+		results[i] = compile_one(sources[i], s);
+	}, threads);
+	double wall = std::chrono::duration<double, std::milli>
+		(steady::now() - start).count(), total = 0;
+	size_t failed = 0;
+	for (size_t i = 0; i < sources.size(); ++i)
+	{
+		const auto &r = results[i];
+		report << sources[i] << ' ' << (r.error.empty() ? "ok" : "FAILED")
+			<< ' ' << r.ms << " ms";
+		if (!r.error.empty())
+			report << ": " << r.error;
+		report << '\n';
+		total += r.ms;
+		failed += !r.error.empty();
+	}
+	report << sources.size() << " programs, " << failed << " failed, "
+		<< total << " ms compiling, " << wall << " ms on " << threads
+		<< " threads" << std::endl;
+	return failed;
+}
+}
@@ -0,0 +1,40 @@
+#ifndef DRIVER_HPP
+#define DRIVER_HPP
+#include "pass.hpp"
+#include "translate.hpp"
+#include <istream>
+#include <ostream>
+#include <string>
+namespace driver
+{
+struct settings
+{
+	pass::options passes;
+	translate::options opt;
+	bool compressed = false; // emit RVC instructions
+	bool elf = false; // an ELF executable instead of hex
+	bool peephole_stats = false;
+};
+// Reads all of text as a decimal number, with no sign, that fits a long;
+// value is left alone if it does not.
+bool parse_count(const std::string &text, long &value);
+// Applies an option of a single compile (--rvc, --elf, --pe-budget=N,
+// --peephole-stats or one of pass::parse_option) to s, and returns false for
+// any other argument or a malformed number.
+bool parse_option(const std::string &arg, settings &s);
+// Compiles the program in is into os; warnings and statistics go to log.
+// With a cache in s.opt, a program compiled before with the same settings by
+// the same compiler is answered from it without running any stage.
+void compile(std::istream &is, std::ostream &os, std::ostream &log,
+		const settings &s);
+/*
+ * Compiles every program named by path, which is a directory (its *.bas
+ * files) or a manifest with one source file per line, on `threads` threads.
+ * The output of a.bas goes to a.hex (a.elf), and its warnings and error, if
+ * any, to a.log; an error only fails the program that threw it.  A line per
+ * program and a summary go to report.  Returns the number of failures.
+ */
+size_t compile_batch(const std::string &path, const settings &s,
+		unsigned threads, std::ostream &report);
+}
+#endif
@@ -0,0 +1,151 @@
+#include "elf.hpp"
+#include <algorithm>
+#include <string>
+#include <vector>
+namespace elf
+{
+const int EHDR_SIZE = 52, PHDR_SIZE = 32, SHDR_SIZE = 40, SYM_SIZE = 16;
+const int EM_RISCV = 243, EF_RISCV_RVC = 1;
+const int ET_EXEC = 2, PT_LOAD = 1, PF_X = 1, PF_R = 4;
+const int SHT_PROGBITS = 1, SHT_SYMTAB = 2, SHT_STRTAB = 3;
+const int SHF_ALLOC = 2, SHF_EXECINSTR = 4;
+const int STB_LOCAL = 0, STB_GLOBAL = 1, STT_NOTYPE = 0, STT_FUNC = 2;
+const int TEXT_IDX = 1, SYMTAB_IDX = 2, STRTAB_IDX = 3, SHSTRTAB_IDX = 4;
+struct buffer
+{
+	std::vector<char> data;
+	void u8(uint8_t x)
+	{
+		data.push_back(x);
+	}
+	void u16(uint16_t x)
+	{
+		u8(x);
+		u8(x >> 8);
+	}
+	void u32(uint32_t x)
+	{
+		u16(x);
+		u16(x >> 16);
+	}
+	void align(size_t n)
+	{
+		while (data.size() % n != 0)
+			u8(0);
+	}
+	template <typename T>
+	void append(const T &bytes)
+	{
+		data.insert(data.end(), bytes.begin(), bytes.end());
+	}
+};
+// adds name to a string table, returning its offset
+uint32_t add_str(std::string &table, const std::string &name)
+{
+	uint32_t ret = table.size();
+	table += name;
+	table += '\0';
+	return ret;
+}
+void write_elf(std::ostream &os, const to_raw::raw_prog &text,
+		const link::symbol_table &symbols, bool compressed)
+{
+	const uint32_t text_off = EHDR_SIZE + PHDR_SIZE;
+	std::string strtab(1, '\0'), shstrtab(1, '\0');
+	buffer symtab;
+	symtab.data.resize(SYM_SIZE); // null symbol
+	auto add_sym = [&](const std::string &name, uint32_t addr, uint32_t size,
+			int bind, int type)
+	{
+		symtab.u32(add_str(strtab, name));
+		symtab.u32(addr);
+		symtab.u32(size);
+		symtab.u8(bind << 4 | type);
+		symtab.u8(0);
+		symtab.u16(TEXT_IDX);
+	};
+	// a block runs up to the next higher address, the last one to the end
+	std::vector<std::pair<uint32_t, size_t>> by_addr;
+	for (const auto &[id, addr] : symbols)
+		by_addr.emplace_back(addr, by_addr.size());
+	std::sort(by_addr.begin(), by_addr.end());
+	std::vector<uint32_t> ends(by_addr.size());
+	uint32_t end = text.size();
+	for (size_t i = by_addr.size(); i-- > 0; )
+	{
+		if (i + 1 < by_addr.size() && by_addr[i + 1].first > by_addr[i].first)
+			end = by_addr[i + 1].first;
+		ends[by_addr[i].second] = end;
+	}
+	size_t i = 0;
+	for (const auto &[id, addr] : symbols)
+		add_sym(id < 0 ? "entry" : "line_" + std::to_string(id),
+				text_off + addr, ends[i++] - addr, STB_LOCAL, STT_NOTYPE);
+	uint32_t first_global = symtab.data.size() / SYM_SIZE;
+	add_sym("_start", text_off, text.size(), STB_GLOBAL, STT_FUNC);
+
+	buffer out;
+	// ELF header
+	out.append(std::string("\x7f" "ELF"));
+	out.u8(1); // ELFCLASS32
+	out.u8(1); // little endian
+	out.u8(1); // EV_CURRENT
+	out.align(16);
+	out.u16(ET_EXEC);
+	out.u16(EM_RISCV);
+	out.u32(1);
+	out.u32(text_off); // entry
+	out.u32(EHDR_SIZE); // program headers
+	size_t shoff_pos = out.data.size();
+	out.u32(0); // section headers, patched below
+	out.u32(compressed ? EF_RISCV_RVC : 0);
+	out.u16(EHDR_SIZE);
+	out.u16(PHDR_SIZE);
+	out.u16(1);
+	out.u16(SHDR_SIZE);
+	out.u16(5);
+	out.u16(SHSTRTAB_IDX);
+	// the only segment: headers and .text
+	out.u32(PT_LOAD);
+	out.u32(0);
+	out.u32(0);
+	out.u32(0);
+	out.u32(text_off + text.size());
+	out.u32(text_off + text.size());
+	out.u32(PF_R | PF_X);
+	out.u32(0x1000);
+	out.append(text);
+	out.align(4);
+	uint32_t symtab_off = out.data.size();
+	out.append(symtab.data);
+	uint32_t strtab_off = out.data.size();
+	out.append(strtab);
+	std::vector<uint32_t> names;
+	for (auto name : {"", ".text", ".symtab", ".strtab", ".shstrtab"})
+		names.push_back(*name == '\0' ? 0 : add_str(shstrtab, name));
+	uint32_t shstrtab_off = out.data.size();
+	out.append(shstrtab);
+	out.align(4);
+	uint32_t shoff = out.data.size();
+	for (int i = 0; i < 4; ++i)
+		out.data[shoff_pos + i] = shoff >> (8 * i);
+	auto section = [&](uint32_t name, uint32_t type, uint32_t flags,
+			uint32_t addr, uint32_t off, uint32_t size, uint32_t link,
+			uint32_t info, uint32_t align, uint32_t entsize)
+	{
+		for (auto x : {name, type, flags, addr, off, size, link, info,
+				align, entsize})
+			out.u32(x);
+	};
+	section(0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+	section(names[TEXT_IDX], SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR,
+			text_off, text_off, text.size(), 0, 0, 4, 0);
+	section(names[SYMTAB_IDX], SHT_SYMTAB, 0, 0, symtab_off,
+			symtab.data.size(), STRTAB_IDX, first_global, 4, SYM_SIZE);
+	section(names[STRTAB_IDX], SHT_STRTAB, 0, 0, strtab_off,
+			strtab.size(), 0, 0, 1, 0);
+	section(names[SHSTRTAB_IDX], SHT_STRTAB, 0, 0, shstrtab_off,
+			shstrtab.size(), 0, 0, 1, 0);
+	os.write(out.data.data(), out.data.size());
+}
+}
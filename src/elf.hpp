@@ -0,0 +1,17 @@
+#ifndef ELF_HPP
+#define ELF_HPP
+#include "to_raw.hpp"
+#include <ostream>
+namespace elf
+{
+/*
+ * Writes a RISC-V ELF32 executable with one read+exec segment holding the
+ * headers and .text, mapped from file offset 0 at address 0; the code is
+ * position independent, so it runs from where .text lands.  Every block is
+ * a local symbol line_<id>, and _start marks the entry point.  The file is
+ * built in memory and written with a single call.
+ */
+void write_elf(std::ostream &os, const to_raw::raw_prog &text,
+		const link::symbol_table &symbols, bool compressed = false);
+}
+#endif
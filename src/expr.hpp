@@ -148,6 +148,11 @@ struct bool_or : bin_op
 	}
 };
 
+// Compiler-generated variables start with '$', which the parser never accepts.
+inline bool is_hidden_id(const std::string &name)
+{
+	return !name.empty() && name[0] == '$';
+}
 id parse_id(const std::string &id_str);
 value_type parse_unsigned_num(const std::string &num_str);
 std::unique_ptr<expr> parse_expr(const std::string &expr_str);
@@ -1,72 +1,61 @@
 #ifndef INST_HPP
 #define INST_HPP
+#include <ostream>
 #include <utility>
+#include <iterator>
+#include <vector>
 namespace inst
 {
 enum class inst_opcode {OP_IMM = 0b0010011, LOAD = 0b0000011, JALR = 0b1100111, LUI = 0b0110111, AUIPC = 0b0010111, OP = 0b0110011, JAL = 0b1101111, BRANCH = 0b1100011, STORE = 0b0100011, SYSTEM = 0b1110011, MISC_MEM = 0b0001111};
-enum class inst_op { ADD, SUB, MUL, DIV, ADDI, LUI, LW, SW, JALR, ECALL, AND, OR, SLTIU, SLT, BEQ, XORI, AUIPC };
+enum class inst_op { ADD, SUB, MUL, DIV, ADDI, LUI, LW, SW, JALR, ECALL, AND, OR, SLTIU, SLT, BEQ, XORI, AUIPC,
+	SLLI, SRLI, SRAI, MULH, JAL, SLTI };
 const int CALL_EXIT = 0, CALL_READ = 1, CALL_PRINT = 2;
 struct instruction
 {
 	inst_op op;
 	int rs1, rs2, imm, rd;
-	void print(std::ostream &os) const
-	{
-		switch (op)
-		{
-#define R_case(op_type)\
-			case inst_op::op_type:\
-				os << #op_type << " x" << rd << ", x" << rs1 << ", x" << rs2;\
-				break;
-#define I_case(op_type)\
-			case inst_op::op_type:\
-				os << #op_type << " x" << rd << ", x" << rs1 << ", " << imm;\
-				break;
-#define S_case(op_type)\
-			case inst_op::op_type:\
-				os << #op_type << ' ' << imm << "(x" << rs1 << "), x" << rs2;\
-				break;
-#define B_case(op_type)\
-			case inst_op::op_type:\
-				os << #op_type << " x" << rs1 << ", x" << rs2 << ", " << imm;\
-				break;
-#define U_case(op_type)\
-			case inst_op::op_type:\
-				os << #op_type << " x" << rd << ", " << imm;\
-				break;
-#define J_case(op_type)\
-			case inst_op::op_type:\
-				os << #op_type << " x" << rd << ", " << imm;\
-				break;
-			R_case(ADD)R_case(SUB)R_case(MUL)R_case(DIV)R_case(AND)R_case(OR)R_case(SLT)
-			I_case(ADDI)I_case(SLTIU)I_case(XORI)I_case(JALR)
-			S_case(SW)
-			B_case(BEQ)
-			U_case(LUI)U_case(AUIPC)
-#undef R_case
-#undef I_case
-#undef S_case
-#undef B_case
-#undef U_case
-#undef J_case
-			case inst_op::ECALL:
-				os << "ECALL";
-				break;
-			case inst_op::LW:
-				os << "LW x" << rd << ", " << imm << "(x" << rs1 << ")";
-		}
-	}
+	void print(std::ostream &os) const; // see isa.cc
 };
 inline std::ostream &operator<< (std::ostream &os, const instruction &x)
 {
 	x.print(os);
 	return os;
 }
-const int zero = 0, sp = 2, t0 = 5, t1 = 6, t2 = 7, a0 = 10, a1 = 11;
+const int zero = 0, ra = 1, sp = 2, gp = 3, tp = 4, t0 = 5, t1 = 6, t2 = 7,
+	s0 = 8, s1 = 9, a0 = 10, a1 = 11;
 const static int REAL_REG = 32;
+/*
+ * Memory slot mem lives at sp + 4 * (mem - REAL_REG), so the first slots
+ * have the small non-negative offsets that compressed loads and stores take.
+ * Only the first NEAR_SLOTS slots are reachable from sp with a 12-bit
+ * offset; the next ones are addressed from far_base_reg[i], which holds
+ * sp + 4096 * (i + 1) and reaches FAR_SLOTS slots.
+ */
+const int NEAR_SLOTS = 512, FAR_SLOTS = 1024;
+inline constexpr int far_base_reg[] = {gp, tp, s0, s1, ra};
+const int MAX_SLOTS = NEAR_SLOTS + FAR_SLOTS * std::size(far_base_reg);
+const int MEM_END = 0x20000;
+// sp is set below the top of memory so that the slots fit above it
+inline constexpr int stack_base(int slots)
+{
+	return (MEM_END - 4 * slots) & ~0xfff;
+}
+inline constexpr int far_base_idx(int mem)
+{
+	return mem - REAL_REG < NEAR_SLOTS
+		? -1 : (mem - REAL_REG - NEAR_SLOTS) / FAR_SLOTS;
+}
+inline constexpr int slot_base(int mem)
+{
+	return far_base_idx(mem) < 0 ? sp : far_base_reg[far_base_idx(mem)];
+}
+inline constexpr int slot_offset(int mem)
+{
+	return 4 * (mem - REAL_REG) - 4096 * (far_base_idx(mem) + 1);
+}
 inline constexpr instruction inst_mem_2_reg(int mem, int reg)
 {
-	return instruction{inst_op::LW, sp, 0, -4 * (mem - REAL_REG + 1), reg};
+	return instruction{inst_op::LW, slot_base(mem), 0, slot_offset(mem), reg};
 }
 inline constexpr instruction inst_reg_2_reg(int rs, int rd)
 {
@@ -74,7 +63,7 @@ inline constexpr instruction inst_reg_2_reg(int rs, int rd)
 }
 inline constexpr instruction inst_reg_2_mem(int reg, int mem)
 {
-	return instruction{inst_op::SW, sp, reg, -4 * (mem - REAL_REG + 1), 0};
+	return instruction{inst_op::SW, slot_base(mem), reg, slot_offset(mem), 0};
 }
 inline constexpr instruction inst_NOP
 	= instruction{inst_op::ADDI, zero, 0, 0, zero};
@@ -83,5 +72,52 @@ inline std::pair<int, int> split_int32(int val) // return {high, low}
 	int low = val << 20 >> 20, high = val - low;
 	return std::make_pair(high, low);
 }
+inline std::vector<instruction> inst_load_imm(int val, int rd)
+{
+	auto &&[high, low] = split_int32(val);
+	if (high == 0)
+		return {instruction{inst_op::ADDI, zero, 0, low, rd}};
+	return {
+		instruction{inst_op::LUI, 0, 0, high, rd},
+		instruction{inst_op::ADDI, rd, 0, low, rd}
+	};
+}
+inline std::pair<int, int> src_regs(const instruction &x) // -1 if unused
+{
+	switch (x.op)
+	{
+		case inst_op::LUI:
+		case inst_op::AUIPC:
+		case inst_op::JAL:
+			return {-1, -1};
+		case inst_op::ADDI:
+		case inst_op::SLTIU:
+		case inst_op::SLTI:
+		case inst_op::XORI:
+		case inst_op::JALR:
+		case inst_op::LW:
+		case inst_op::SLLI:
+		case inst_op::SRLI:
+		case inst_op::SRAI:
+			return {x.rs1, -1};
+		case inst_op::ECALL:
+			return {a0, a1};
+		default:
+			return {x.rs1, x.rs2};
+	}
+}
+inline int dst_reg(const instruction &x) // -1 if none
+{
+	switch (x.op)
+	{
+		case inst_op::SW:
+		case inst_op::BEQ:
+			return -1;
+		case inst_op::ECALL:
+			return a0;
+		default:
+			return x.rd;
+	}
+}
 }
 #endif
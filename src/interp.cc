@@ -0,0 +1,374 @@
+#include "interp.hpp"
+#include <map>
+#include <string>
+#include <typeinfo>
+namespace interp
+{
+struct compiler
+{
+	program ret;
+	const array::sizes &arrays;
+	std::map<std::string, int> var_idx;
+	std::map<statement::line_num, size_t> line_pos;
+	std::vector<size_t> fixups; // positions whose c holds a line number
+	size_t depth = 0;
+	compiler(const array::sizes &_arrays) : ret{{}, 0, 0}, arrays(_arrays) {}
+	void emit(opcode op, int a = 0, int b = 0, int c = 0)
+	{
+		ret.code.push_back(instruction{op, a, b, c});
+	}
+	void emit_jump(opcode op, statement::line_num line, int a = 0, int b = 0)
+	{
+		fixups.push_back(ret.code.size());
+		emit(op, a, b, line);
+	}
+	void push()
+	{
+		if (++depth > ret.stack_size)
+			ret.stack_size = depth;
+	}
+	int var(const expr::expr &e)
+	{
+		if (typeid(e) != typeid(expr::id))
+			throw "lvalue expected.";
+		const auto &name = static_cast<const expr::id&>(e).id_name;
+		auto it = var_idx.find(name);
+		if (it != var_idx.end())
+			return it->second;
+		return var_idx[name] = ret.var_cnt++;
+	}
+	// pushes the index of element e; returns its array's first variable
+	int element(const expr::expr &e, int &size)
+	{
+		const auto &sub = static_cast<const expr::subscript&>(e);
+		value(*sub.rc);
+		const auto &name = static_cast<const expr::id&>(*sub.lc).id_name;
+		auto it = arrays.find(name);
+		if (it == arrays.end())
+			throw "Unknown array.";
+		size = it->second;
+		auto pos = var_idx.find(name);
+		if (pos != var_idx.end())
+			return pos->second;
+		ret.var_cnt += size;
+		return var_idx[name] = ret.var_cnt - size;
+	}
+	void value(const expr::expr &e)
+	{
+		const auto &type = typeid(e);
+		if (type == typeid(expr::imm_num))
+		{
+			emit(opcode::PUSH_IMM, static_cast<const expr::imm_num&>(e).value);
+			push();
+			return;
+		}
+		if (type == typeid(expr::id))
+		{
+			emit(opcode::PUSH_VAR, var(e));
+			push();
+			return;
+		}
+		if (type == typeid(expr::subscript))
+		{
+			int size, base = element(e, size);
+			return emit(opcode::LOAD_ELEM, base, size);
+		}
+		if (type == typeid(expr::neg))
+		{
+			value(*static_cast<const expr::neg&>(e).c);
+			emit(opcode::NEG);
+			return;
+		}
+		const auto &bin_expr = static_cast<const expr::bin_op&>(e);
+		value(*bin_expr.lc);
+		if (type == typeid(expr::add)
+				&& typeid(*bin_expr.rc) == typeid(expr::imm_num))
+		{
+			emit(opcode::ADD_IMM,
+					static_cast<const expr::imm_num&>(*bin_expr.rc).value);
+			return;
+		}
+		value(*bin_expr.rc);
+		--depth;
+		if (type == typeid(expr::add))
+			emit(opcode::ADD);
+		else if (type == typeid(expr::sub))
+			emit(opcode::SUB);
+		else if (type == typeid(expr::mul))
+			emit(opcode::MUL);
+		else if (type == typeid(expr::div))
+			emit(opcode::DIV);
+		else if (type == typeid(expr::bool_and))
+			emit(opcode::AND);
+		else if (type == typeid(expr::bool_or))
+			emit(opcode::OR);
+		else
+			emit(opcode(int(opcode::LT)
+						+ static_cast<const expr::cmp&>(e).op));
+	}
+	void assign(const statement::assignment &a)
+	{
+		if (typeid(*a.var) == typeid(expr::subscript))
+		{
+			int size, base = element(*a.var, size);
+			value(*a.val);
+			emit(opcode::STORE_ELEM, base, size);
+			depth -= 2;
+			return;
+		}
+		int dst = var(*a.var);
+		const auto &val = *a.val;
+		const auto &type = typeid(val);
+		if (type == typeid(expr::imm_num))
+			return emit(opcode::SET_IMM, dst,
+					static_cast<const expr::imm_num&>(val).value);
+		if (type == typeid(expr::id))
+			return emit(opcode::MOV, dst, var(val));
+		if (type == typeid(expr::add))
+		{
+			const auto &sum = static_cast<const expr::add&>(val);
+			for (auto [x, c] : {std::make_pair(&*sum.lc, &*sum.rc),
+					std::make_pair(&*sum.rc, &*sum.lc)})
+				if (typeid(*x) == typeid(expr::id)
+						&& typeid(*c) == typeid(expr::imm_num)
+						&& var(*x) == dst)
+					return emit(opcode::INC_VAR, dst,
+							static_cast<const expr::imm_num&>(*c).value);
+		}
+		value(val);
+		emit(opcode::STORE, dst);
+		--depth;
+	}
+	// jump to line if cond is (when_true) or is not (!when_true) satisfied
+	void branch(const expr::expr &cond, bool when_true,
+			statement::line_num line)
+	{
+		if (typeid(cond) == typeid(expr::cmp))
+		{
+			const auto &c = static_cast<const expr::cmp&>(cond);
+			// LT..NE negated
+			const int negated[] = {3, 2, 1, 0, 5, 4};
+			int op = when_true ? c.op : negated[c.op];
+			if (typeid(*c.lc) == typeid(expr::id)
+					&& typeid(*c.rc) == typeid(expr::imm_num))
+				return emit_jump(opcode(int(opcode::JLT_VI) + op), line,
+						var(*c.lc),
+						static_cast<const expr::imm_num&>(*c.rc).value);
+			if (typeid(*c.lc) == typeid(expr::id)
+					&& typeid(*c.rc) == typeid(expr::id))
+				return emit_jump(opcode(int(opcode::JLT_VV) + op), line,
+						var(*c.lc), var(*c.rc));
+		}
+		value(cond);
+		emit_jump(when_true ? opcode::JNZ : opcode::JZ, line);
+		--depth;
+	}
+	void input(const expr::expr &e)
+	{
+		if (typeid(e) != typeid(expr::subscript))
+			return emit(opcode::INPUT, var(e));
+		int size, base = element(e, size);
+		emit(opcode::INPUT_ELEM, base, size);
+		--depth;
+	}
+};
+program compile(const statement::program_type &prog,
+		const array::sizes &arrays)
+{
+	compiler comp(arrays);
+	for (auto it = prog.begin(); it != prog.end(); ++it)
+	{
+		const auto &[line, sent] = *it;
+		comp.line_pos[line] = comp.ret.code.size();
+		const auto &type = typeid(*sent);
+		if (type == typeid(statement::LET))
+			comp.assign(static_cast<const statement::LET&>(*sent).assign);
+		else if (type == typeid(statement::INPUT))
+			for (const auto &var :
+					static_cast<const statement::INPUT&>(*sent).inputs)
+				comp.input(*var);
+		else if (type == typeid(statement::EXIT))
+		{
+			comp.value(*static_cast<const statement::EXIT&>(*sent).val);
+			comp.emit(opcode::EXIT);
+			--comp.depth;
+		}
+		else if (type == typeid(statement::GOTO))
+			comp.emit_jump(opcode::JMP,
+					static_cast<const statement::GOTO&>(*sent).line);
+		else if (type == typeid(statement::IF))
+		{
+			const auto &if_sent = static_cast<const statement::IF&>(*sent);
+			comp.branch(*if_sent.condition, true, if_sent.line);
+		}
+		else if (type == typeid(statement::FOR))
+		{
+			const auto &for_sent = static_cast<const statement::FOR&>(*sent);
+			auto after = prog.upper_bound(for_sent.end_for_line);
+			comp.branch(*for_sent.condition, false, after == prog.end()
+					? statement::additional_exit_line : after->first);
+		}
+		else if (type == typeid(statement::END_FOR))
+		{
+			const auto &end_for =
+				static_cast<const statement::END_FOR&>(*sent);
+			comp.assign(end_for.step_statement);
+			comp.emit_jump(opcode::JMP, end_for.for_line);
+		}
+	}
+	for (auto pos : comp.fixups)
+	{
+		auto &c = comp.ret.code[pos].c;
+		auto it = comp.line_pos.find(c);
+		if (it == comp.line_pos.end())
+			throw "Jump to unknown line.";
+		c = it->second;
+	}
+	return std::move(comp.ret);
+}
+inline int32_t wrap(int64_t x)
+{
+	return int32_t(uint32_t(x));
+}
+int32_t run(const program &prog, std::istream &input)
+{
+	struct threaded
+	{
+		const void *handler;
+		opcode op;
+		int a, b, c;
+	};
+	std::vector<int32_t> vars(prog.var_cnt, 0), stack(prog.stack_size + 1);
+	std::vector<threaded> code;
+#if defined(__GNUC__)
+#define INTERP_LABEL_ADDR(name) &&L_##name,
+	static const void *const labels[] = { INTERP_OPS(INTERP_LABEL_ADDR) };
+#undef INTERP_LABEL_ADDR
+	for (const auto &x : prog.code)
+		code.push_back(threaded{labels[int(x.op)], x.op, x.a, x.b, x.c});
+#define DISPATCH() goto *ip->handler
+#else
+	for (const auto &x : prog.code)
+		code.push_back(threaded{nullptr, x.op, x.a, x.b, x.c});
+#define INTERP_CASE(name) case opcode::name: goto L_##name;
+#define DISPATCH() switch (ip->op) { INTERP_OPS(INTERP_CASE) }
+#endif
+	const threaded *ip = code.data();
+	int32_t *top = stack.data(), *var = vars.data();
+#define NEXT() do { ++ip; DISPATCH(); } while (0)
+#define JUMP(cond) do {\
+		ip = (cond) ? code.data() + ip->c : ip + 1; DISPATCH(); } while (0)
+#define BIN_OP(name, expr) L_##name: {\
+		int32_t r = *--top, l = top[-1]; top[-1] = (expr); NEXT(); }
+#define CMP_JUMPS(suffix, rhs)\
+	L_JLT##suffix: JUMP(var[ip->a] < (rhs));\
+	L_JLE##suffix: JUMP(var[ip->a] <= (rhs));\
+	L_JGT##suffix: JUMP(var[ip->a] > (rhs));\
+	L_JGE##suffix: JUMP(var[ip->a] >= (rhs));\
+	L_JEQ##suffix: JUMP(var[ip->a] == (rhs));\
+	L_JNE##suffix: JUMP(var[ip->a] != (rhs));
+	DISPATCH();
+L_PUSH_VAR:
+	*top++ = var[ip->a];
+	NEXT();
+L_PUSH_IMM:
+	*top++ = ip->a;
+	NEXT();
+L_ADD_IMM:
+	top[-1] = wrap(int64_t(top[-1]) + ip->a);
+	NEXT();
+	BIN_OP(ADD, wrap(int64_t(l) + r))
+	BIN_OP(SUB, wrap(int64_t(l) - r))
+	BIN_OP(MUL, wrap(int64_t(l) * r))
+	BIN_OP(DIV, r == 0 ? -1 : wrap(int64_t(l) / r))
+	BIN_OP(AND, l & r)
+	BIN_OP(OR, l | r)
+	BIN_OP(LT, l < r)
+	BIN_OP(LE, l <= r)
+	BIN_OP(GT, l > r)
+	BIN_OP(GE, l >= r)
+	BIN_OP(EQ, l == r)
+	BIN_OP(NE, l != r)
+L_NEG:
+	top[-1] = wrap(-int64_t(top[-1]));
+	NEXT();
+L_STORE:
+	var[ip->a] = *--top;
+	NEXT();
+L_SET_IMM:
+	var[ip->a] = ip->b;
+	NEXT();
+L_MOV:
+	var[ip->a] = var[ip->b];
+	NEXT();
+L_INC_VAR:
+	var[ip->a] = wrap(int64_t(var[ip->a]) + ip->b);
+	NEXT();
+L_JMP:
+	JUMP(true);
+L_JZ:
+	JUMP(*--top == 0);
+L_JNZ:
+	JUMP(*--top != 0);
+	CMP_JUMPS(_VI, ip->b)
+	CMP_JUMPS(_VV, var[ip->b])
+L_LOAD_ELEM:
+	{
+		uint32_t i = top[-1];
+		if (i >= uint32_t(ip->b))
+			throw "Array index out of bounds.";
+		top[-1] = var[ip->a + i];
+	}
+	NEXT();
+L_STORE_ELEM:
+	{
+		int32_t val = *--top;
+		uint32_t i = *--top;
+		if (i >= uint32_t(ip->b))
+			throw "Array index out of bounds.";
+		var[ip->a + i] = val;
+	}
+	NEXT();
+L_INPUT_ELEM:
+	{
+		uint32_t i = *--top;
+		int64_t val;
+		if (i >= uint32_t(ip->b))
+			throw "Array index out of bounds.";
+		if (!(input >> val))
+			throw "Not enough input.";
+		var[ip->a + i] = wrap(val);
+	}
+	NEXT();
+L_INPUT:
+	{
+		int64_t val;
+		if (!(input >> val))
+			throw "Not enough input.";
+		var[ip->a] = wrap(val);
+	}
+	NEXT();
+L_EXIT:
+	return *--top;
+#undef CMP_JUMPS
+#undef BIN_OP
+#undef JUMP
+#undef NEXT
+#undef DISPATCH
+#undef INTERP_CASE
+}
+void print_program(std::ostream &os, const program &prog)
+{
+#define INTERP_NAME(name) #name,
+	static const char *const names[] = { INTERP_OPS(INTERP_NAME) };
+#undef INTERP_NAME
+	for (size_t i = 0; i < prog.code.size(); ++i)
+	{
+		const auto &x = prog.code[i];
+		os << i << ":\t" << names[int(x.op)] << ' ' << x.a << ' ' << x.b
+			<< ' ' << x.c << '\n';
+	}
+	os << prog.var_cnt << " variables, stack " << prog.stack_size
+		<< std::endl;
+}
+}
@@ -0,0 +1,49 @@
+#ifndef INTERP_HPP
+#define INTERP_HPP
+#include "array.hpp"
+#include "statement.hpp"
+#include <cstdint>
+#include <istream>
+#include <vector>
+namespace interp
+{
+#define INTERP_CMP_OPS(X, suffix)\
+	X(JLT##suffix) X(JLE##suffix) X(JGT##suffix)\
+	X(JGE##suffix) X(JEQ##suffix) X(JNE##suffix)
+// a, b, c: variable indices, immediates or jump targets (code positions);
+// the *_ELEM ops take the index from the stack, a first element and b size
+#define INTERP_OPS(X)\
+	X(PUSH_VAR) X(PUSH_IMM) X(ADD) X(ADD_IMM) X(SUB) X(MUL) X(DIV) X(NEG)\
+	X(AND) X(OR) X(LT) X(LE) X(GT) X(GE) X(EQ) X(NE)\
+	X(STORE) X(SET_IMM) X(MOV) X(INC_VAR)\
+	X(LOAD_ELEM) X(STORE_ELEM) X(INPUT_ELEM)\
+	X(JMP) X(JZ) X(JNZ)\
+	INTERP_CMP_OPS(X, _VI) INTERP_CMP_OPS(X, _VV)\
+	X(INPUT) X(EXIT)
+#define INTERP_ENUM(name) name,
+enum class opcode { INTERP_OPS(INTERP_ENUM) };
+#undef INTERP_ENUM
+struct instruction
+{
+	opcode op;
+	int a, b, c;
+};
+struct program
+{
+	std::vector<instruction> code;
+	size_t var_cnt, stack_size;
+};
+/*
+ * Bytecode for a stack machine with superinstructions for x = x + c,
+ * x = c, x = y and compare-and-branch on a variable.  Arithmetic matches
+ * the compiled RV32IM code: it wraps, and division by zero gives -1.
+ * An array of prog, lowered by array::lower, takes that many consecutive
+ * variables, and its indices are checked at run time.
+ */
+program compile(const statement::program_type &prog,
+		const array::sizes &arrays = {});
+// Runs until EXIT and returns its value.
+int32_t run(const program &prog, std::istream &input);
+void print_program(std::ostream &os, const program &prog);
+}
+#endif
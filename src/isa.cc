@@ -0,0 +1,80 @@
+#include "isa.hpp"
+namespace isa
+{
+instruction decode(uint32_t raw)
+{
+	int opcode = raw & 0x7f, funct3 = raw >> 12 & 0x7, funct7 = raw >> 25;
+	int rd = raw >> 7 & 0x1f, rs1 = raw >> 15 & 0x1f, rs2 = raw >> 20 & 0x1f;
+	int32_t sraw = raw;
+	for (const auto &d : table)
+	{
+		if (int(d.opcode) != opcode
+				|| (has_funct3(d.fmt) && d.funct3 != funct3)
+				|| (has_funct7(d.fmt) && d.funct7 != funct7))
+			continue;
+		switch (d.fmt)
+		{
+			case format::R:
+				return instruction{d.op, rs1, rs2, 0, rd};
+			case format::I:
+			case format::L:
+				return instruction{d.op, rs1, 0, sraw >> 20, rd};
+			case format::SHIFT:
+				return instruction{d.op, rs1, 0, rs2, rd};
+			case format::SYS:
+				if (raw != uint32_t(d.opcode))
+					continue;
+				return instruction{d.op, 0, 0, 0, 0};
+			case format::S:
+				return instruction{d.op, rs1, rs2,
+					sraw >> 25 << 5 | rd, 0};
+			case format::B:
+				return instruction{d.op, rs1, rs2,
+					sraw >> 31 << 12 | (rd & 1) << 11
+						| (funct7 & 0x3f) << 5 | (rd & 0x1e), 0};
+			case format::U:
+				return instruction{d.op, 0, 0, int(raw & 0xfffff000), rd};
+			case format::J:
+				return instruction{d.op, 0, 0,
+					sraw >> 31 << 20 | int(raw >> 12 & 0xff) << 12
+						| int(raw >> 20 & 1) << 11
+						| int(raw >> 21 & 0x3ff) << 1,
+					rd};
+		}
+	}
+	throw "Unknown instruction";
+}
+void print(std::ostream &os, const instruction &x)
+{
+	const auto &d = describe(x.op);
+	os << d.name;
+	switch (d.fmt)
+	{
+		case format::R:
+			os << " x" << x.rd << ", x" << x.rs1 << ", x" << x.rs2;
+			break;
+		case format::I:
+		case format::SHIFT:
+			os << " x" << x.rd << ", x" << x.rs1 << ", " << x.imm;
+			break;
+		case format::L:
+			os << " x" << x.rd << ", " << x.imm << "(x" << x.rs1 << ")";
+			break;
+		case format::SYS:
+			break;
+		case format::S:
+			os << ' ' << x.imm << "(x" << x.rs1 << "), x" << x.rs2;
+			break;
+		case format::B:
+			os << " x" << x.rs1 << ", x" << x.rs2 << ", " << x.imm;
+			break;
+		case format::U:
+		case format::J:
+			os << " x" << x.rd << ", " << x.imm;
+	}
+}
+}
+void inst::instruction::print(std::ostream &os) const
+{
+	isa::print(os, *this);
+}
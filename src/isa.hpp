@@ -0,0 +1,122 @@
+#ifndef ISA_HPP
+#define ISA_HPP
+#include "inst.hpp"
+#include <array>
+#include <cstdint>
+#include <iterator>
+#include <ostream>
+#include <utility>
+namespace isa
+{
+using inst::inst_op;
+using inst::inst_opcode;
+using inst::instruction;
+// SHIFT is I-type with a 5-bit immediate, L and SYS are I-type printed as a
+// load and as a bare name
+enum class format { R, I, SHIFT, L, SYS, S, B, U, J };
+struct desc
+{
+	inst_op op;
+	const char *name;
+	format fmt;
+	inst_opcode opcode;
+	int funct3, funct7;
+};
+// indexed by inst_op
+inline constexpr desc table[] = {
+	{inst_op::ADD,   "ADD",   format::R,     inst_opcode::OP,     0b000, 0b0000000},
+	{inst_op::SUB,   "SUB",   format::R,     inst_opcode::OP,     0b000, 0b0100000},
+	{inst_op::MUL,   "MUL",   format::R,     inst_opcode::OP,     0b000, 0b0000001},
+	{inst_op::DIV,   "DIV",   format::R,     inst_opcode::OP,     0b100, 0b0000001},
+	{inst_op::ADDI,  "ADDI",  format::I,     inst_opcode::OP_IMM, 0b000, 0},
+	{inst_op::LUI,   "LUI",   format::U,     inst_opcode::LUI,    0,     0},
+	{inst_op::LW,    "LW",    format::L,     inst_opcode::LOAD,   0b010, 0},
+	{inst_op::SW,    "SW",    format::S,     inst_opcode::STORE,  0b010, 0},
+	{inst_op::JALR,  "JALR",  format::I,     inst_opcode::JALR,   0b000, 0},
+	{inst_op::ECALL, "ECALL", format::SYS,   inst_opcode::SYSTEM, 0b000, 0},
+	{inst_op::AND,   "AND",   format::R,     inst_opcode::OP,     0b111, 0b0000000},
+	{inst_op::OR,    "OR",    format::R,     inst_opcode::OP,     0b110, 0b0000000},
+	{inst_op::SLTIU, "SLTIU", format::I,     inst_opcode::OP_IMM, 0b011, 0},
+	{inst_op::SLT,   "SLT",   format::R,     inst_opcode::OP,     0b010, 0b0000000},
+	{inst_op::BEQ,   "BEQ",   format::B,     inst_opcode::BRANCH, 0b000, 0},
+	{inst_op::XORI,  "XORI",  format::I,     inst_opcode::OP_IMM, 0b100, 0},
+	{inst_op::AUIPC, "AUIPC", format::U,     inst_opcode::AUIPC,  0,     0},
+	{inst_op::SLLI,  "SLLI",  format::SHIFT, inst_opcode::OP_IMM, 0b001, 0b0000000},
+	{inst_op::SRLI,  "SRLI",  format::SHIFT, inst_opcode::OP_IMM, 0b101, 0b0000000},
+	{inst_op::SRAI,  "SRAI",  format::SHIFT, inst_opcode::OP_IMM, 0b101, 0b0100000},
+	{inst_op::MULH,  "MULH",  format::R,     inst_opcode::OP,     0b001, 0b0000001},
+	{inst_op::JAL,   "JAL",   format::J,     inst_opcode::JAL,    0,     0},
+	{inst_op::SLTI,  "SLTI",  format::I,     inst_opcode::OP_IMM, 0b010, 0},
+};
+constexpr bool table_in_order()
+{
+	for (size_t i = 0; i < std::size(table); ++i)
+		if (table[i].op != inst_op(i))
+			return false;
+	return std::size(table) == size_t(inst_op::SLTI) + 1;
+}
+static_assert(table_in_order(), "isa::table must list every inst_op in order");
+constexpr const desc &describe(inst_op op)
+{
+	return table[size_t(op)];
+}
+constexpr bool has_funct3(format f)
+{
+	return f != format::U && f != format::J;
+}
+constexpr bool has_funct7(format f)
+{
+	return f == format::R || f == format::SHIFT;
+}
+template <format F>
+constexpr uint32_t encode_fields(const instruction &x, const desc &d)
+{
+	uint32_t imm = x.imm, ret = uint32_t(d.opcode);
+	if constexpr (has_funct3(F))
+		ret |= d.funct3 << 12;
+	if constexpr (has_funct7(F))
+		ret |= d.funct7 << 25;
+	if constexpr (F == format::R)
+		ret |= x.rs2 << 20 | x.rs1 << 15 | x.rd << 7;
+	else if constexpr (F == format::SHIFT)
+		ret |= (imm & 0x1f) << 20 | x.rs1 << 15 | x.rd << 7;
+	else if constexpr (F == format::I || F == format::L || F == format::SYS)
+		ret |= imm << 20 | x.rs1 << 15 | x.rd << 7;
+	else if constexpr (F == format::S)
+		ret |= (imm >> 5) << 25 | x.rs2 << 20 | x.rs1 << 15
+			| (imm & 0x1f) << 7;
+	else if constexpr (F == format::B)
+		ret |= (imm >> 12 & 1) << 31 | (imm >> 5 & 0x3f) << 25
+			| x.rs2 << 20 | x.rs1 << 15
+			| (imm >> 1 & 0xf) << 8 | (imm >> 11 & 1) << 7;
+	else if constexpr (F == format::U)
+		ret |= (imm & 0xfffff000) | x.rd << 7;
+	else if constexpr (F == format::J)
+		ret |= (imm >> 20 & 1) << 31 | (imm >> 1 & 0x3ff) << 21
+			| (imm >> 11 & 1) << 20 | (imm >> 12 & 0xff) << 12 | x.rd << 7;
+	return ret;
+}
+// encoder specialized for one opcode
+template <inst_op Op>
+constexpr uint32_t encode(const instruction &x)
+{
+	constexpr const desc &d = describe(Op);
+	return encode_fields<d.fmt>(x, d);
+}
+template <size_t... I>
+constexpr auto make_encoders(std::index_sequence<I...>)
+{
+	using encoder = uint32_t (*)(const instruction &);
+	return std::array<encoder, sizeof...(I)>{encode<inst_op(I)>...};
+}
+inline constexpr auto encoders
+	= make_encoders(std::make_index_sequence<std::size(table)>());
+inline uint32_t encode(const instruction &x)
+{
+	return encoders[size_t(x.op)](x);
+}
+// throws on words that are not in the table
+instruction decode(uint32_t raw);
+void print(std::ostream &os, const instruction &x);
+}
+#endif
@@ -0,0 +1,330 @@
+#include "jit.hpp"
+#include <cstddef>
+#include <cstring>
+#include <map>
+#include <string>
+#include <typeinfo>
+#include <vector>
+#if defined(__x86_64__) && defined(__linux__)
+#include <sys/mman.h>
+#define JIT_SUPPORTED
+#endif
+namespace jit
+{
+struct host_context
+{
+	std::istream *input;
+	bool input_failed, index_failed;
+	int32_t exit_val;
+};
+int32_t host_input(host_context *ctx, int32_t *var)
+{
+	int64_t val;
+	if (!(*ctx->input >> val))
+	{
+		ctx->input_failed = true;
+		return 0;
+	}
+	*var = int32_t(uint32_t(val));
+	return 1;
+}
+int32_t host_exit(host_context *ctx, int32_t val)
+{
+	return ctx->exit_val = val;
+}
+struct assembler
+{
+	const array::sizes &arrays;
+	std::vector<uint8_t> code;
+	std::map<std::string, int> var_idx; // first slot
+	int slot_cnt = 0;
+	std::map<int, size_t> block_pos;
+	std::vector<std::pair<size_t, int>> block_fixups; // rel32 -> block
+	std::vector<size_t> fail_fixups; // rel32 -> input failure stub
+	std::vector<size_t> bounds_fixups; // rel32 -> bad index stub
+	assembler(const array::sizes &_arrays) : arrays(_arrays) {}
+	void bytes(std::initializer_list<uint8_t> b)
+	{
+		code.insert(code.end(), b);
+	}
+	void imm32(int32_t x)
+	{
+		for (int i = 0; i < 4; ++i)
+			code.push_back(uint32_t(x) >> (8 * i));
+	}
+	void imm64(uint64_t x)
+	{
+		for (int i = 0; i < 8; ++i)
+			code.push_back(x >> (8 * i));
+	}
+	int32_t slot_disp(const std::string &name, int size)
+	{
+		auto it = var_idx.find(name);
+		if (it != var_idx.end())
+			return 4 * it->second;
+		slot_cnt += size;
+		return 4 * (var_idx[name] = slot_cnt - size);
+	}
+	int32_t disp(const expr::expr &var)
+	{
+		if (typeid(var) != typeid(expr::id))
+			throw "lvalue expected.";
+		return slot_disp(static_cast<const expr::id&>(var).id_name, 1);
+	}
+	// eax = index of element e, checked; returns the disp32 of its array
+	int32_t element(const expr::expr &e)
+	{
+		const auto &sub = static_cast<const expr::subscript&>(e);
+		value(*sub.rc);
+		const auto &name = static_cast<const expr::id&>(*sub.lc).id_name;
+		auto it = arrays.find(name);
+		if (it == arrays.end())
+			throw "Unknown array.";
+		bytes({0x3D}); // cmp eax, imm32
+		imm32(it->second);
+		bytes({0x0F, 0x83}); // jae bad index
+		bounds_fixups.push_back(code.size());
+		imm32(0);
+		return slot_disp(name, it->second);
+	}
+	void jump_rel32(std::initializer_list<uint8_t> op, int block)
+	{
+		bytes(op);
+		block_fixups.emplace_back(code.size(), block);
+		imm32(0);
+	}
+	void call(uint64_t fn)
+	{
+		bytes({0x48, 0xB8}); // mov rax, fn
+		imm64(fn);
+		bytes({0xFF, 0xD0}); // call rax
+	}
+	void epilogue()
+	{
+		bytes({0x41, 0x5D, 0x41, 0x5C, 0x5B, 0xC3}); // pop r13, r12, rbx
+	}
+	// eax = divisor ecx == 0 ? -1 : ecx == -1 ? -eax : eax / ecx
+	void div_ecx()
+	{
+		bytes({0x85, 0xC9, 0x74, 10, 0x83, 0xF9, 0xFF, 0x74, 12,
+				0x99, 0xF7, 0xF9, 0xEB, 9,
+				0xB8, 0xFF, 0xFF, 0xFF, 0xFF, 0xEB, 2,
+				0xF7, 0xD8});
+	}
+	// eax = e; rcx and the stack are used for temporaries
+	void value(const expr::expr &e)
+	{
+		const auto &type = typeid(e);
+		if (type == typeid(expr::imm_num))
+		{
+			bytes({0xB8}); // mov eax, imm32
+			imm32(static_cast<const expr::imm_num&>(e).value);
+			return;
+		}
+		if (type == typeid(expr::id))
+		{
+			bytes({0x8B, 0x83}); // mov eax, [rbx + disp32]
+			imm32(disp(e));
+			return;
+		}
+		if (type == typeid(expr::subscript))
+		{
+			int32_t d = element(e);
+			bytes({0x8B, 0x84, 0x83}); // mov eax, [rbx + rax * 4 + disp32]
+			imm32(d);
+			return;
+		}
+		if (type == typeid(expr::neg))
+		{
+			value(*static_cast<const expr::neg&>(e).c);
+			bytes({0xF7, 0xD8}); // neg eax
+			return;
+		}
+		const auto &bin_expr = static_cast<const expr::bin_op&>(e);
+		const auto &rtype = typeid(*bin_expr.rc);
+		bool simple_rhs = rtype == typeid(expr::imm_num)
+			|| rtype == typeid(expr::id);
+		if (simple_rhs)
+			value(*bin_expr.lc);
+		else
+		{
+			value(*bin_expr.rc);
+			bytes({0x50}); // push rax
+			value(*bin_expr.lc);
+			bytes({0x59}); // pop rcx
+		}
+		if (simple_rhs)
+		{
+			if (rtype == typeid(expr::imm_num))
+				bytes({0xB9}); // mov ecx, imm32
+			else
+				bytes({0x8B, 0x8B}); // mov ecx, [rbx + disp32]
+			imm32(rtype == typeid(expr::imm_num)
+					? static_cast<const expr::imm_num&>(*bin_expr.rc).value
+					: disp(*bin_expr.rc));
+		}
+		if (type == typeid(expr::add))
+			bytes({0x01, 0xC8});
+		else if (type == typeid(expr::sub))
+			bytes({0x29, 0xC8});
+		else if (type == typeid(expr::mul))
+			bytes({0x0F, 0xAF, 0xC1});
+		else if (type == typeid(expr::div))
+			div_ecx();
+		else if (type == typeid(expr::bool_and))
+			bytes({0x21, 0xC8});
+		else if (type == typeid(expr::bool_or))
+			bytes({0x09, 0xC8});
+		else
+		{
+			// LT, LE, GT, GE, EQ, NE
+			const uint8_t setcc[] = {0x9C, 0x9E, 0x9F, 0x9D, 0x94, 0x95};
+			bytes({0x39, 0xC8, 0x0F, setcc[static_cast<const expr::cmp&>(e)
+					.op], 0xC0, 0x0F, 0xB6, 0xC0});
+		}
+	}
+	void assign(const statement::assignment &a)
+	{
+		value(*a.val);
+		if (typeid(*a.var) == typeid(expr::subscript))
+		{
+			bytes({0x50}); // push rax
+			int32_t d = element(*a.var);
+			bytes({0x59}); // pop rcx
+			bytes({0x89, 0x8C, 0x83}); // mov [rbx + rax * 4 + disp32], ecx
+			imm32(d);
+			return;
+		}
+		bytes({0x89, 0x83}); // mov [rbx + disp32], eax
+		imm32(disp(*a.var));
+	}
+	void input(const expr::expr &var)
+	{
+		// rdi = r12, rsi = &var
+		if (typeid(var) == typeid(expr::subscript))
+		{
+			int32_t d = element(var);
+			bytes({0x4C, 0x89, 0xE7, 0x48, 0x8D, 0xB4, 0x83});
+			imm32(d);
+		}
+		else
+		{
+			bytes({0x4C, 0x89, 0xE7, 0x48, 0x8D, 0xB3});
+			imm32(disp(var));
+		}
+		call(reinterpret_cast<uint64_t>(host_input));
+		bytes({0x85, 0xC0, 0x0F, 0x84}); // test eax, eax; jz fail
+		fail_fixups.push_back(code.size());
+		imm32(0);
+	}
+	void exit(const expr::expr &val)
+	{
+		value(val);
+		bytes({0x4C, 0x89, 0xE7, 0x89, 0xC6}); // rdi = r12, esi = eax
+		call(reinterpret_cast<uint64_t>(host_exit));
+		epilogue();
+	}
+	void patch(size_t pos, size_t target)
+	{
+		int32_t rel = int64_t(target) - int64_t(pos + 4);
+		std::memcpy(&code[pos], &rel, 4);
+	}
+};
+program compile(const basic_block::cfg_type &cfg,
+		const array::sizes &arrays)
+{
+#ifndef JIT_SUPPORTED
+	(void)cfg;
+	(void)arrays;
+	throw "JIT is only supported on x86-64 Linux.";
+#else
+	assembler as(arrays);
+	// push rbx, r12, r13 (keeps rsp aligned at calls); rbx = vars, r12 = ctx,
+	// r13 = rsp to leave from the middle of an expression on a bad index
+	as.bytes({0x53, 0x41, 0x54, 0x41, 0x55,
+			0x48, 0x89, 0xFB, 0x49, 0x89, 0xF4, 0x49, 0x89, 0xE5});
+	for (auto it = cfg.begin(); it != cfg.end(); ++it)
+	{
+		const auto &[id, block] = *it;
+		as.block_pos[id] = as.code.size();
+		for (const auto &sent : block.commands)
+		{
+			const auto &type = typeid(*sent);
+			if (type == typeid(statement::LET))
+				as.assign(static_cast<statement::LET&>(*sent).assign);
+			else if (type == typeid(statement::END_FOR))
+				as.assign(static_cast<statement::END_FOR&>(*sent)
+						.step_statement);
+			else if (type == typeid(statement::INPUT))
+				for (const auto &var :
+						static_cast<statement::INPUT&>(*sent).inputs)
+					as.input(*var);
+			else if (type == typeid(statement::EXIT))
+				as.exit(*static_cast<statement::EXIT&>(*sent).val);
+		}
+		auto nxt = std::next(it);
+		int fall = nxt == cfg.end() ? basic_block::END_IDX : nxt->first;
+		if (block.condition != nullptr)
+		{
+			as.value(*block.condition);
+			as.bytes({0x85, 0xC0}); // test eax, eax
+			as.jump_rel32({0x0F, 0x85}, block.jump_true); // jnz
+			if (block.jump_false != fall)
+				as.jump_rel32({0xE9}, block.jump_false);
+		}
+		else if (block.jump_true != basic_block::END_IDX
+				&& block.jump_true != fall)
+			as.jump_rel32({0xE9}, block.jump_true);
+	}
+	size_t bounds_pos = as.code.size();
+	// mov rsp, r13; mov byte [r12 + index_failed], 1
+	as.bytes({0x4C, 0x89, 0xEC, 0x41, 0xC6, 0x44, 0x24,
+			offsetof(host_context, index_failed), 1});
+	size_t fail_pos = as.code.size();
+	as.bytes({0x31, 0xC0}); // xor eax, eax
+	as.epilogue();
+	for (auto [pos, block] : as.block_fixups)
+		as.patch(pos, as.block_pos.at(block));
+	for (auto pos : as.fail_fixups)
+		as.patch(pos, fail_pos);
+	for (auto pos : as.bounds_fixups)
+		as.patch(pos, bounds_pos);
+	void *mem = mmap(nullptr, as.code.size(), PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (mem == MAP_FAILED)
+		throw "Cannot map memory for JIT code.";
+	std::memcpy(mem, as.code.data(), as.code.size());
+	if (mprotect(mem, as.code.size(), PROT_READ | PROT_EXEC) != 0)
+	{
+		munmap(mem, as.code.size());
+		throw "Cannot make JIT code executable.";
+	}
+	return program(mem, as.code.size(), as.slot_cnt);
+#endif
+}
+program::program(program &&other)
+	: code(other.code), size(other.size), var_cnt(other.var_cnt)
+{
+	other.code = nullptr;
+}
+program::~program()
+{
+#ifdef JIT_SUPPORTED
+	if (code != nullptr)
+		munmap(code, size);
+#endif
+}
+int32_t program::run(std::istream &input) const
+{
+	std::vector<int32_t> vars(var_cnt + 1, 0);
+	host_context ctx{&input, false, false, 0};
+	auto entry = reinterpret_cast<int32_t (*)(int32_t *, host_context *)>
+		(code);
+	int32_t ret = entry(vars.data(), &ctx);
+	if (ctx.input_failed)
+		throw "Not enough input.";
+	if (ctx.index_failed)
+		throw "Array index out of bounds.";
+	return ret;
+}
+}
@@ -0,0 +1,32 @@
+#ifndef JIT_HPP
+#define JIT_HPP
+#include "array.hpp"
+#include "basic_block.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+namespace jit
+{
+/*
+ * x86-64 machine code for a CFG, in an mmap'd buffer that is made
+ * executable once written.  Variables live in an array addressed by rbx;
+ * INPUT and EXIT call back into the host.  Array indices are checked.  Only
+ * available on x86-64 Linux, elsewhere compile throws.
+ */
+class program
+{
+	void *code;
+	size_t size, var_cnt;
+public:
+	program(void *_code, size_t _size, size_t _var_cnt)
+		: code(_code), size(_size), var_cnt(_var_cnt) {}
+	program(program &&other);
+	program(const program &) = delete;
+	~program();
+	// Runs until EXIT and returns its value, reading INPUT from input.
+	int32_t run(std::istream &input) const;
+};
+program compile(const basic_block::cfg_type &cfg,
+		const array::sizes &arrays = {});
+}
+#endif
@@ -1,55 +1,196 @@
 #include "link.hpp"
+#include <algorithm>
 #include <map>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
 namespace link
 {
 using namespace inst;
-linked_prog link(const translate::obj_code &obj)
+// Chains blocks along their hottest fall-through edges (Pettis and Hansen).
+std::vector<int> block_order(const translate::obj_code &obj,
+		const profile::counts *prof)
 {
-	linked_prog ret;
-	std::map<int, int> block_pc_map;
-	std::map<int, int> block_jump_pos;
-	ret.push_back(instruction{inst_op::LUI, 0, 0, 0x20 << 12, sp});
+	std::vector<int> ret;
+	if (prof == nullptr)
+	{
+		for (const auto &[block_id, block] : obj)
+			ret.push_back(block_id);
+		return ret;
+	}
+	// only the edge to jump_true can fall through; the profile has block
+	// counts, so a conditional edge is estimated as the smaller count
+	std::vector<std::tuple<long, int, int>> edges;
 	for (const auto &[block_id, block] : obj)
 	{
-		block_pc_map[block_id] = ret.size() * 4;
-		ret.insert(ret.end(),
-				block.instructions.begin(), block.instructions.end());
-		block_jump_pos[block_id] = ret.size();
-		if (block.condition == nullptr)
+		int v = block.jump_true;
+		if (v == basic_block::END_IDX || v == block_id)
+			continue;
+		long w = profile::count_of(*prof, block_id);
+		if (block.condition != nullptr)
+			w = std::min(w, profile::count_of(*prof, v));
+		if (w > 0)
+			edges.emplace_back(w, block_id, v);
+	}
+	std::stable_sort(edges.begin(), edges.end(),
+			[](const auto &a, const auto &b)
+			{
+				return std::get<0>(a) > std::get<0>(b);
+			});
+	int entry = obj.begin()->first;
+	std::map<int, int> next, prev;
+	std::map<int, int> head; // block -> first block of its chain
+	for (const auto &[block_id, block] : obj)
+		head[block_id] = block_id;
+	for (const auto &[w, u, v] : edges)
+	{
+		if (next.count(u) != 0 || prev.count(v) != 0 || v == entry
+				|| head[u] == head[v])
+			continue;
+		next[u] = v;
+		prev[v] = u;
+		for (int x = v; ; x = next[x])
 		{
-			if (block.jump_true != basic_block::END_IDX)
-				ret.insert(ret.end(), 2, inst_NOP);
+			head[x] = head[u];
+			if (next.count(x) == 0)
+				break;
 		}
-		else
-			ret.insert(ret.end(), 5, inst_NOP);
 	}
+	std::vector<std::pair<long, int>> chains; // hottest block, head
 	for (const auto &[block_id, block] : obj)
-	{
-		auto pos = block_jump_pos[block_id];
-		if (block.condition == nullptr)
+		if (prev.count(block_id) == 0 && block_id != entry)
 		{
-			if (block.jump_true != basic_block::END_IDX)
+			long hottest = 0;
+			for (int x = block_id; ; x = next[x])
 			{
-				int delta_pc = block_pc_map[block.jump_true] - pos * 4;
-				auto &&[high, low] = split_int32(delta_pc);
-				ret[pos++] = instruction{inst_op::AUIPC, 0, 0, high, t0};
-				ret[pos++] = instruction{inst_op::JALR, t0, 0, low, zero};
+				hottest = std::max(hottest, profile::count_of(*prof, x));
+				if (next.count(x) == 0)
+					break;
 			}
+			chains.emplace_back(hottest, block_id);
+		}
+	std::stable_sort(chains.begin(), chains.end(),
+			[](const auto &a, const auto &b)
+			{
+				return a.first > b.first;
+			});
+	chains.insert(chains.begin(), {0, entry});
+	for (const auto &[hottest, first] : chains)
+		for (int x = first; ; x = next[x])
+		{
+			ret.push_back(x);
+			if (next.count(x) == 0)
+				break;
 		}
+	return ret;
+}
+// Jumps to a block not placed yet are chained through the immediate of
+// their AUIPC, and the chain is patched when the block is placed.
+struct emitter
+{
+	linked_prog code;
+	std::vector<int> addr, chain; // by block index; -1 if none
+	explicit emitter(size_t blocks) : addr(blocks, -1), chain(blocks, -1) {}
+	void patch(int pos, int target_addr)
+	{
+		auto &&[high, low] = split_int32(target_addr - pos * 4);
+		code[pos] = instruction{inst_op::AUIPC, 0, 0, high, t0};
+		code[pos + 1] = instruction{inst_op::JALR, t0, 0, low, zero};
+	}
+	// a target outside the program is address 0
+	void jump(int target)
+	{
+		int pos = code.size();
+		code.insert(code.end(), 2, inst_NOP);
+		if (target == -1 || addr[target] != -1)
+			patch(pos, target == -1 ? 0 : addr[target]);
 		else
 		{
-			ret[pos++] = instruction{inst_op::BEQ, a0, zero, 3 * 4, 0};
-			auto &&[h1, l1] =
-				split_int32(block_pc_map[block.jump_true] - pos * 4);
-			ret[pos++] = instruction{inst_op::AUIPC, 0, 0, h1, t0};
-			ret[pos++] = instruction{inst_op::JALR, t0, 0, l1, zero};
-			auto &&[h2, l2] =
-				split_int32(block_pc_map[block.jump_false] - pos * 4);
-			ret[pos++] = instruction{inst_op::AUIPC, 0, 0, h2, t0};
-			ret[pos++] = instruction{inst_op::JALR, t0, 0, l2, zero};
+			code[pos].imm = chain[target];
+			chain[target] = pos;
 		}
 	}
-	return ret;
+	void place(int block)
+	{
+		addr[block] = code.size() * 4;
+		for (int pos = chain[block]; pos != -1; )
+		{
+			int next = code[pos].imm;
+			patch(pos, addr[block]);
+			pos = next;
+		}
+	}
+};
+// with a mutable obj each block's code is freed once it is copied
+template <class OBJ>
+linked_prog link_blocks(OBJ &obj, const profile::counts *prof,
+		symbol_table *symbols)
+{
+	std::vector<int> ids;
+	std::unordered_map<int, int> index_of;
+	std::vector<decltype(&obj.begin()->second)> blocks;
+	ids.reserve(obj.size());
+	index_of.reserve(obj.size());
+	size_t size = 1;
+	for (auto &[block_id, block] : obj)
+	{
+		index_of.emplace(block_id, ids.size());
+		ids.push_back(block_id);
+		blocks.push_back(&block);
+		size += block.instructions.size() + 5;
+	}
+	auto index = [&](int block_id)
+	{
+		auto it = index_of.find(block_id);
+		return it == index_of.end() ? -1 : it->second;
+	};
+	emitter out(blocks.size());
+	out.code.reserve(size);
+	out.code.push_back(instruction{inst_op::LUI, 0, 0, stack_base(obj.slots),
+			sp});
+	for (int block_id : block_order(obj, prof))
+	{
+		int i = index(block_id);
+		auto &block = *blocks[i];
+		out.place(i);
+		out.code.insert(out.code.end(),
+				block.instructions.begin(), block.instructions.end());
+		if constexpr (!std::is_const_v<OBJ>)
+			std::vector<instruction>().swap(block.instructions);
+		if (block.condition == nullptr)
+		{
+			if (block.jump_true != basic_block::END_IDX)
+				out.jump(index(block.jump_true));
+			continue;
+		}
+		out.code.push_back(instruction{inst_op::BEQ, a0, zero, 3 * 4, 0});
+		out.jump(index(block.jump_true));
+		out.jump(index(block.jump_false));
+	}
+	if (symbols != nullptr)
+	{
+		symbols->clear();
+		for (size_t i = 0; i < ids.size(); ++i)
+			symbols->emplace_hint(symbols->end(), ids[i], out.addr[i]);
+	}
+	if constexpr (!std::is_const_v<OBJ>)
+		obj.clear();
+	return std::move(out.code);
+}
+linked_prog link(const translate::obj_code &obj, const profile::counts *prof,
+		symbol_table *symbols)
+{
+	return link_blocks(obj, prof, symbols);
+}
+linked_prog link(translate::obj_code &&obj, const profile::counts *prof,
+		symbol_table *symbols)
+{
+	return link_blocks(obj, prof, symbols);
+}
+void check_size(size_t bytes, int slots)
+{
+	if (bytes > size_t(stack_base(slots)))
+		throw "Program too large.";
 }
 void print_linked_code(std::ostream &os, const linked_prog &code)
 {
@@ -5,7 +5,22 @@ namespace link
 {
 using namespace inst;
 using linked_prog = std::vector<instruction>;
-linked_prog link(const translate::obj_code &obj);
+using symbol_table = std::map<int, int>; // block id -> address
+/*
+ * Without a profile blocks are laid out in id order.  With one, each block
+ * is followed by its most executed successor not placed yet, and blocks
+ * that never ran go last.
+ */
+linked_prog link(const translate::obj_code &obj,
+		const profile::counts *prof = nullptr,
+		symbol_table *symbols = nullptr);
+// the same, freeing obj as it goes
+linked_prog link(translate::obj_code &&obj,
+		const profile::counts *prof = nullptr,
+		symbol_table *symbols = nullptr);
+// Throws if bytes of code starting at 0 run into the slots above sp; call it
+// on the final encoding, as jumps and instructions get shorter after link.
+void check_size(size_t bytes, int slots);
 void print_linked_code(std::ostream &os, const linked_prog &code);
 }
 #endif
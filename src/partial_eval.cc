@@ -0,0 +1,234 @@
+#include "partial_eval.hpp"
+#include <typeinfo>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <queue>
+namespace partial_eval
+{
+using basic_block::cfg_type;
+using basic_block::END_IDX;
+using basic_block::BEGIN_IDX;
+using env_type = std::map<std::string, int32_t>;
+// Same results as the RV32IM instructions the expression compiles to.
+bool eval(const expr::expr &e, const env_type &env, int32_t &val)
+{
+	const auto &type = typeid(e);
+	if (type == typeid(expr::imm_num))
+	{
+		val = static_cast<const expr::imm_num&>(e).value;
+		return true;
+	}
+	if (type == typeid(expr::id))
+	{
+		auto it = env.find(static_cast<const expr::id&>(e).id_name);
+		val = it == env.end() ? 0 : it->second;
+		return true;
+	}
+	if (type == typeid(expr::neg))
+	{
+		if (!eval(*static_cast<const expr::neg&>(e).c, env, val))
+			return false;
+		val = -uint32_t(val);
+		return true;
+	}
+	if (type == typeid(expr::subscript))
+		return false;
+	const auto &bin_expr = static_cast<const expr::bin_op&>(e);
+	int32_t l, r;
+	if (!eval(*bin_expr.lc, env, l) || !eval(*bin_expr.rc, env, r))
+		return false;
+	if (type == typeid(expr::add))
+		val = uint32_t(l) + uint32_t(r);
+	else if (type == typeid(expr::sub))
+		val = uint32_t(l) - uint32_t(r);
+	else if (type == typeid(expr::mul))
+		val = uint32_t(l) * uint32_t(r);
+	else if (type == typeid(expr::div))
+		val = r == 0 ? -1 : r == -1 ? -uint32_t(l) : l / r;
+	else if (type == typeid(expr::bool_and))
+		val = l & r;
+	else if (type == typeid(expr::bool_or))
+		val = l | r;
+	else
+		switch (static_cast<const expr::cmp&>(e).op)
+		{
+			case expr::cmp::LT: val = l < r; break;
+			case expr::cmp::LE: val = l <= r; break;
+			case expr::cmp::GT: val = l > r; break;
+			case expr::cmp::GE: val = l >= r; break;
+			case expr::cmp::EQ: val = l == r; break;
+			default: val = l != r;
+		}
+	return true;
+}
+bool assign(const statement::assignment &assign, env_type &env)
+{
+	int32_t val;
+	if (typeid(*assign.var) != typeid(expr::id)
+			|| !eval(*assign.val, env, val))
+		return false;
+	env[static_cast<const expr::id&>(*assign.var).id_name] = val;
+	return true;
+}
+// false if sent has to be left to run time
+bool execute(const statement::statement &sent, env_type &env)
+{
+	const auto &type = typeid(sent);
+	if (type == typeid(statement::LET))
+		return assign(static_cast<const statement::LET&>(sent).assign, env);
+	if (type == typeid(statement::END_FOR))
+		return assign(static_cast<const statement::END_FOR&>(sent)
+				.step_statement, env);
+	int32_t cond;
+	if (type == typeid(statement::IF))
+		return eval(*static_cast<const statement::IF&>(sent).condition,
+				env, cond);
+	if (type == typeid(statement::FOR))
+		return eval(*static_cast<const statement::FOR&>(sent).condition,
+				env, cond);
+	return type != typeid(statement::INPUT) && type != typeid(statement::EXIT);
+}
+void collect_ids(const expr::expr &e, std::set<std::string> &out)
+{
+	const auto &type = typeid(e);
+	if (type == typeid(expr::id))
+		out.insert(static_cast<const expr::id&>(e).id_name);
+	else if (type == typeid(expr::neg))
+		collect_ids(*static_cast<const expr::neg&>(e).c, out);
+	else if (type == typeid(expr::subscript)) // arrays are not variables
+		collect_ids(*static_cast<const expr::subscript&>(e).rc, out);
+	else if (type != typeid(expr::imm_num))
+	{
+		collect_ids(*static_cast<const expr::bin_op&>(e).lc, out);
+		collect_ids(*static_cast<const expr::bin_op&>(e).rc, out);
+	}
+}
+// variables the block mentions, and those it assigns
+void block_vars(const basic_block::basic_block_type &block,
+		std::set<std::string> &used, std::set<std::string> &defined)
+{
+	auto def = [&](const expr::expr &var)
+	{
+		if (typeid(var) == typeid(expr::id))
+			defined.insert(static_cast<const expr::id&>(var).id_name);
+		collect_ids(var, used);
+	};
+	for (const auto &sent : block.commands)
+	{
+		const auto &type = typeid(*sent);
+		if (type == typeid(statement::LET))
+		{
+			const auto &a = static_cast<statement::LET&>(*sent).assign;
+			def(*a.var);
+			collect_ids(*a.val, used);
+		}
+		else if (type == typeid(statement::END_FOR))
+		{
+			const auto &a =
+				static_cast<statement::END_FOR&>(*sent).step_statement;
+			def(*a.var);
+			collect_ids(*a.val, used);
+		}
+		else if (type == typeid(statement::INPUT))
+			for (const auto &var : static_cast<statement::INPUT&>(*sent).inputs)
+				def(*var);
+		else if (type == typeid(statement::EXIT))
+			collect_ids(*static_cast<statement::EXIT&>(*sent).val, used);
+	}
+	if (block.condition != nullptr)
+		collect_ids(*block.condition, used);
+}
+void remove_unreachable(cfg_type &cfg)
+{
+	std::set<int> reachable{cfg.begin()->first};
+	std::queue<int> q;
+	q.push(cfg.begin()->first);
+	while (!q.empty())
+	{
+		for (int v : basic_block::successors(cfg.at(q.front())))
+			if (reachable.insert(v).second)
+				q.push(v);
+		q.pop();
+	}
+	for (auto it = cfg.begin(); it != cfg.end(); )
+		if (reachable.count(it->first) == 0)
+			it = cfg.erase(it);
+		else
+			++it;
+}
+void evaluate(cfg_type &cfg, long budget)
+{
+	if (cfg.empty() || cfg.begin()->first == BEGIN_IDX)
+		return;
+	env_type env;
+	int cur = cfg.begin()->first;
+	size_t pos = 0;
+	bool exited = false;
+	int32_t exit_val = 0;
+	for (long steps = 0; steps < budget; ++steps)
+	{
+		const auto &block = cfg.at(cur);
+		if (pos < block.commands.size())
+		{
+			const auto &sent = *block.commands[pos];
+			if (typeid(sent) == typeid(statement::EXIT)
+					&& eval(*static_cast<const statement::EXIT&>(sent).val,
+						env, exit_val))
+			{
+				exited = true;
+				break;
+			}
+			if (!execute(sent, env))
+				break;
+			if (++pos < block.commands.size())
+				continue;
+		}
+		int32_t cond = 1;
+		if (block.condition != nullptr)
+			eval(*block.condition, env, cond);
+		int nxt = cond != 0 ? block.jump_true : block.jump_false;
+		if (nxt == END_IDX)
+			break;
+		cur = nxt;
+		pos = 0;
+	}
+	if (cur == cfg.begin()->first && pos == 0 && !exited)
+		return;
+	std::vector<std::unique_ptr<statement::statement>> commands;
+	if (exited)
+	{
+		commands.push_back(std::make_unique<statement::EXIT>
+				(std::make_unique<expr::imm_num>(exit_val)));
+		cfg.emplace(BEGIN_IDX, basic_block::basic_block_type
+				(std::move(commands), nullptr, END_IDX, BEGIN_IDX));
+		remove_unreachable(cfg);
+		return;
+	}
+	const auto &block = cfg.at(cur);
+	for (size_t i = pos; i < block.commands.size(); ++i)
+		commands.push_back(block.commands[i]->deep_copy());
+	cfg.emplace(BEGIN_IDX, basic_block::basic_block_type
+			(std::move(commands),
+			 block.condition == nullptr ? nullptr : block.condition->deep_copy(),
+			 block.jump_true, block.jump_false));
+	remove_unreachable(cfg);
+	std::set<std::string> used, defined;
+	for (const auto &[id, b] : cfg)
+		block_vars(b, used, defined);
+	std::vector<std::unique_ptr<statement::statement>> init;
+	for (const auto &var : used)
+	{
+		auto it = env.find(var);
+		if (it == env.end() && defined.count(var) != 0)
+			continue;
+		init.push_back(std::make_unique<statement::LET>(statement::assignment
+				(std::make_unique<expr::id>(var),
+				 std::make_unique<expr::imm_num>
+					(it == env.end() ? 0 : it->second))));
+	}
+	auto &entry = cfg.at(BEGIN_IDX).commands;
+	entry.insert(entry.begin(), std::make_move_iterator(init.begin()),
+			std::make_move_iterator(init.end()));
+}
+}
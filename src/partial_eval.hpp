@@ -0,0 +1,16 @@
+#ifndef PARTIAL_EVAL_HPP
+#define PARTIAL_EVAL_HPP
+#include "basic_block.hpp"
+namespace partial_eval
+{
+const long DEFAULT_BUDGET = 1000000;
+/*
+ * Runs the program at compile time from its first line until it reaches an
+ * INPUT, an expression it cannot evaluate or the end of the step budget
+ * (statements executed).  The rest of the program is kept as a new entry
+ * block (id BEGIN_IDX) assigning the values computed so far, followed by
+ * whatever is still reachable from it.
+ */
+void evaluate(basic_block::cfg_type &cfg, long budget = DEFAULT_BUDGET);
+}
+#endif
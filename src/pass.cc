@@ -0,0 +1,346 @@
+#include "pass.hpp"
+#include "dead_store.hpp"
+#include "isa.hpp"
+#include "schedule.hpp"
+#include "value_number.hpp"
+#include <iterator>
+#include <typeinfo>
+namespace pass
+{
+using namespace inst;
+using basic_block::cfg_type;
+const unsigned O1 = 1, O2 = 2, OS = 4;
+// exactly one of cfg, block and linked is set; preserves is the analyses a
+// cfg pass leaves valid
+struct info
+{
+	const char *name;
+	unsigned levels, preserves;
+	void (*cfg)(cfg_type &, const options &, manager &);
+	void (*block)(std::vector<instruction> &, bool branch, peephole::stats &);
+	void (*linked)(link::linked_prog &, link::symbol_table &,
+			peephole::stats &);
+};
+const info registry[] = {
+	{"partial-eval", O2, 0, [](cfg_type &cfg, const options &opt, manager &)
+		{
+			partial_eval::evaluate(cfg, opt.pe_budget);
+		}, nullptr, nullptr},
+	{"value-number", O1 | O2 | OS, DOMINATORS | LOOP_DEPTH,
+		[](cfg_type &cfg, const options &, manager &m)
+		{
+			value_number::eliminate_redundancy(cfg, m.dominators(cfg));
+		}, nullptr, nullptr},
+	{"dead-store", O1 | O2 | OS, DOMINATORS | LOOP_DEPTH,
+		[](cfg_type &cfg, const options &, manager &)
+		{
+			dead_store::eliminate(cfg);
+		}, nullptr, nullptr},
+	{"peephole", O1 | O2 | OS, 0, nullptr,
+		[](std::vector<instruction> &code, bool, peephole::stats &st)
+		{
+			peephole::optimize_block(code, st);
+		}, nullptr},
+	{"schedule", O2 | OS, 0, nullptr,
+		[](std::vector<instruction> &code, bool branch, peephole::stats &)
+		{
+			static const auto model = schedule::default_model();
+			schedule::schedule_block(code, model, branch ? a0 : -1);
+		}, nullptr},
+	{"peephole-linked", O1 | O2 | OS, 0, nullptr, nullptr,
+		[](link::linked_prog &code, link::symbol_table &symbols,
+				peephole::stats &st)
+		{
+			peephole::optimize_linked(code, st, &symbols);
+		}},
+};
+// adds the pass named after the '=' of arg to names, if there is one
+bool add_pass(const std::string &arg, std::set<std::string> &names)
+{
+	auto name = arg.substr(arg.find('=') + 1);
+	for (const auto &p : registry)
+		if (name == p.name)
+		{
+			names.insert(name);
+			return true;
+		}
+	return false;
+}
+bool parse_option(const std::string &arg, options &opt)
+{
+	if (arg == "-O0")
+		opt.opt_level = level::O0;
+	else if (arg == "-O1")
+		opt.opt_level = level::O1;
+	else if (arg == "-O2")
+		opt.opt_level = level::O2;
+	else if (arg == "-Os")
+		opt.opt_level = level::Os;
+	else if (arg == "--verify-passes")
+		opt.verify = true;
+	else if (arg == "--print-after=all")
+		opt.print_after.insert("all");
+	else if (arg.rfind("--disable-pass=", 0) == 0)
+		return add_pass(arg, opt.disabled);
+	else if (arg.rfind("--print-after=", 0) == 0)
+		return add_pass(arg, opt.print_after);
+	else
+		return false;
+	return true;
+}
+/*
+ * Every jump lands on a block, only the last command of a block jumps or
+ * exits, a block with a condition ends in the IF or FOR computing it, and
+ * hidden variables are assigned once.
+ */
+void verify_cfg(const cfg_type &cfg)
+{
+	std::set<std::string> hidden;
+	for (const auto &[id, block] : cfg)
+	{
+		if ((block.jump_true != basic_block::END_IDX
+					&& cfg.count(block.jump_true) == 0)
+				|| (block.condition != nullptr
+					&& block.jump_false != basic_block::END_IDX
+					&& cfg.count(block.jump_false) == 0))
+			throw "Jump to a missing block.";
+		const auto &commands = block.commands;
+		for (size_t i = 0; i < commands.size(); ++i)
+		{
+			const auto &type = typeid(*commands[i]);
+			bool branch = type == typeid(statement::IF)
+				|| type == typeid(statement::FOR);
+			if ((branch || type == typeid(statement::GOTO)
+						|| type == typeid(statement::EXIT))
+					&& i + 1 != commands.size())
+				throw "Jump before the end of a block.";
+			if (type != typeid(statement::LET))
+				continue;
+			const auto &var = *static_cast<statement::LET&>(*commands[i])
+				.assign.var;
+			if (typeid(var) == typeid(expr::id)
+					&& expr::is_hidden_id(static_cast<const expr::id&>(var)
+						.id_name)
+					&& !hidden.insert(static_cast<const expr::id&>(var)
+						.id_name).second)
+				throw "Hidden variable assigned twice.";
+		}
+		if (block.condition != nullptr && (commands.empty()
+					|| (typeid(*commands.back()) != typeid(statement::IF)
+						&& typeid(*commands.back()) != typeid(statement::FOR))))
+			throw "Block condition without a branch.";
+	}
+}
+bool imm_fits(const instruction &x)
+{
+	switch (isa::describe(x.op).fmt)
+	{
+		case isa::format::I:
+		case isa::format::L:
+		case isa::format::S:
+			return x.imm >= -2048 && x.imm < 2048;
+		case isa::format::SHIFT:
+			return x.imm >= 0 && x.imm < 32;
+		case isa::format::B:
+			return x.imm % 2 == 0 && x.imm >= -4096 && x.imm < 4096;
+		case isa::format::U:
+			return x.imm % 4096 == 0;
+		case isa::format::J:
+			return x.imm % 2 == 0 && x.imm >= -(1 << 20) && x.imm < (1 << 20);
+		default:
+			return true;
+	}
+}
+// registers exist and immediates fit their fields; blocks leave sp alone
+void verify_code(const std::vector<instruction> &code, bool linked)
+{
+	for (const auto &x : code)
+	{
+		auto &&[r1, r2] = src_regs(x);
+		int rd = dst_reg(x);
+		for (int r : {r1, r2, rd})
+			if (r < -1 || r >= REAL_REG)
+				throw "Register out of range.";
+		if (!imm_fits(x))
+			throw "Immediate out of range.";
+		if (!linked && rd == sp)
+			throw "Block writes sp.";
+	}
+}
+// and every jump lands inside the program
+void verify_linked(const link::linked_prog &code)
+{
+	verify_code(code, true);
+	long end = 4 * long(code.size());
+	for (size_t i = 0; i < code.size(); ++i)
+	{
+		long target = -1;
+		if (code[i].op == inst_op::BEQ || code[i].op == inst_op::JAL)
+			target = 4 * long(i) + code[i].imm;
+		else if (code[i].op == inst_op::AUIPC && i + 1 < code.size()
+				&& code[i + 1].op == inst_op::JALR
+				&& code[i + 1].rs1 == code[i].rd)
+			target = 4 * long(i) + code[i].imm + code[i + 1].imm;
+		else
+			continue;
+		if (target < 0 || target >= end || target % 4 != 0)
+			throw "Jump out of the program.";
+	}
+}
+// runs verify, telling log which stage broke the invariant
+template <class F>
+void check(const char *stage, std::ostream &log, F verify)
+{
+	try
+	{
+		verify();
+	}
+	catch (const char *)
+	{
+		log << "verifier: invariant broken by " << stage << '\n';
+		throw;
+	}
+}
+bool manager::enabled(size_t p) const
+{
+	const unsigned bits[] = {0, O1, O2, OS};
+	return (registry[p].levels & bits[size_t(opt.opt_level)]) != 0
+		&& opt.disabled.count(registry[p].name) == 0;
+}
+bool manager::printed(size_t p) const
+{
+	return opt.print_after.count("all") != 0
+		|| opt.print_after.count(registry[p].name) != 0;
+}
+// drops the analyses a pass did not preserve; with verify on, the others
+// must come out the same when computed again
+void manager::keep(unsigned preserved, const cfg_type &cfg)
+{
+	if ((preserved & DOMINATORS) == 0)
+		idom.reset();
+	if ((preserved & LOOP_DEPTH) == 0)
+		depth.reset();
+	if ((preserved & INTERFERENCE) == 0)
+		hidden.reset();
+	if (!opt.verify)
+		return;
+	if (idom && *idom != basic_block::gen_idom(cfg))
+		throw "Dominators not preserved.";
+	if (depth && *depth != basic_block::loop_depth(cfg))
+		throw "Loop depth not preserved.";
+	if (hidden && *hidden != basic_block::hidden_interference(cfg))
+		throw "Interference not preserved.";
+}
+void manager::run_cfg(cfg_type &cfg)
+{
+	if (opt.verify)
+		check("gen_cfg", log, [&] { verify_cfg(cfg); });
+	for (size_t p = 0; p < std::size(registry); ++p)
+	{
+		if (registry[p].cfg == nullptr || !enabled(p))
+			continue;
+		registry[p].cfg(cfg, opt, *this);
+		if (printed(p))
+		{
+			log << "after " << registry[p].name << ":\n";
+			basic_block::print_cfg(log, cfg);
+		}
+		check(registry[p].name, log, [&]
+		{
+			keep(registry[p].preserves, cfg);
+			if (opt.verify)
+				verify_cfg(cfg);
+		});
+	}
+}
+const std::map<int, int> &manager::dominators(const cfg_type &cfg)
+{
+	if (!idom)
+		idom = basic_block::gen_idom(cfg);
+	return *idom;
+}
+const std::map<int, int> &manager::loop_depth(const cfg_type &cfg)
+{
+	if (!depth)
+		depth = basic_block::loop_depth(cfg, dominators(cfg));
+	return *depth;
+}
+const basic_block::interference_map &
+manager::interference(const cfg_type &cfg)
+{
+	if (!hidden)
+		hidden = basic_block::hidden_interference(cfg);
+	return *hidden;
+}
+void manager::prepare_layout(const cfg_type &cfg, translate::options &to)
+{
+	if (opt.opt_level == level::O0)
+		return;
+	if (to.prof == nullptr)
+		to.loop_depth = &loop_depth(cfg);
+	to.interference = &interference(cfg);
+}
+bool manager::per_block() const
+{
+	if (opt.verify)
+		return false;
+	for (size_t p = 0; p < std::size(registry); ++p)
+		if (registry[p].block != nullptr && enabled(p) && printed(p))
+			return false;
+	return true;
+}
+void manager::run_block(std::vector<instruction> &code, bool branch)
+{
+	peephole::stats st;
+	for (size_t p = 0; p < std::size(registry); ++p)
+		if (registry[p].block != nullptr && enabled(p))
+			registry[p].block(code, branch, st);
+	std::lock_guard<std::mutex> guard(stats_lock);
+	for (size_t i = 0; i < st.fired.size(); ++i)
+		stats.fired[i] += st.fired[i];
+}
+void manager::run_code(translate::obj_code &code)
+{
+	auto verify = [&]
+	{
+		for (const auto &[id, block] : code)
+			verify_code(block.instructions, false);
+	};
+	if (opt.verify)
+		check("translate", log, verify);
+	for (size_t p = 0; p < std::size(registry); ++p)
+	{
+		if (registry[p].block == nullptr || !enabled(p))
+			continue;
+		for (auto &[id, block] : code)
+			registry[p].block(block.instructions,
+					block.condition != nullptr, stats);
+		if (printed(p))
+		{
+			log << "after " << registry[p].name << ":\n";
+			translate::print_obj_code_block(log, code);
+		}
+		if (opt.verify)
+			check(registry[p].name, log, verify);
+	}
+}
+void manager::run_linked(link::linked_prog &code,
+		link::symbol_table &symbols)
+{
+	if (opt.verify)
+		check("link", log, [&] { verify_linked(code); });
+	for (size_t p = 0; p < std::size(registry); ++p)
+	{
+		if (registry[p].linked == nullptr || !enabled(p))
+			continue;
+		registry[p].linked(code, symbols, stats);
+		if (printed(p))
+		{
+			log << "after " << registry[p].name << ":\n";
+			link::print_linked_code(log, code);
+		}
+		if (opt.verify)
+			check(registry[p].name, log, [&] { verify_linked(code); });
+	}
+}
+}
@@ -0,0 +1,78 @@
+#ifndef PASS_HPP
+#define PASS_HPP
+#include "link.hpp"
+#include "partial_eval.hpp"
+#include "peephole.hpp"
+#include <map>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <set>
+#include <string>
+#include <vector>
+namespace pass
+{
+enum class level { O0, O1, O2, Os };
+struct options
+{
+	level opt_level = level::O2;
+	long pe_budget = partial_eval::DEFAULT_BUDGET;
+	std::set<std::string> disabled; // not run at any level
+	std::set<std::string> print_after; // "all" prints after every pass
+	bool verify = false; // check the invariants after every pass
+};
+// Applies -O0, -O1, -O2, -Os, --disable-pass=NAME, --print-after=NAME or
+// --verify-passes to opt, and returns false for any other argument,
+// including one naming no pass.
+bool parse_option(const std::string &arg, options &opt);
+// analyses of the CFG, as bits of the set a pass preserves
+enum analysis : unsigned
+{
+	DOMINATORS = 1, // basic_block::gen_idom
+	LOOP_DEPTH = 2, // basic_block::loop_depth
+	INTERFERENCE = 4, // basic_block::hidden_interference
+};
+/*
+ * Runs the passes of the level that are not disabled, in registry order:
+ *   partial-eval, value-number, dead-store   on the CFG
+ *   peephole, schedule                       on the code of each block
+ *   peephole-linked                          on the linked program
+ * -O2 runs all of them, -O1 leaves out partial-eval and schedule, -Os leaves
+ * out partial-eval, which can copy code, and -O0 runs none.  Output asked for
+ * by print_after goes to log, and the verifier throws on the first broken
+ * invariant, naming the pass that broke it in log.  Analyses are computed
+ * when first asked for and kept until a pass that does not preserve them
+ * runs; the verifier also checks that those kept are still right.
+ */
+class manager
+{
+	const options &opt;
+	std::ostream &log;
+	std::mutex stats_lock;
+	std::optional<std::map<int, int>> idom, depth;
+	std::optional<basic_block::interference_map> hidden;
+	bool enabled(size_t p) const;
+	bool printed(size_t p) const;
+	void keep(unsigned preserved, const basic_block::cfg_type &cfg);
+public:
+	peephole::stats stats; // of both peephole passes
+	manager(const options &_opt, std::ostream &_log) : opt(_opt), log(_log) {}
+	void run_cfg(basic_block::cfg_type &cfg);
+	// analyses of the CFG given to run_cfg, reused while they stay valid
+	const std::map<int, int> &dominators(const basic_block::cfg_type &cfg);
+	const std::map<int, int> &loop_depth(const basic_block::cfg_type &cfg);
+	const basic_block::interference_map &
+	interference(const basic_block::cfg_type &cfg);
+	// gives translate the analyses its layout needs, except at -O0, which
+	// skips the weighted layout and constant pinning
+	void prepare_layout(const basic_block::cfg_type &cfg,
+			translate::options &to);
+	// false if code passes print or verify, so they must see whole programs
+	bool per_block() const;
+	// runs the code passes on one block; safe from several threads
+	void run_block(std::vector<inst::instruction> &code, bool branch);
+	void run_code(translate::obj_code &code);
+	void run_linked(link::linked_prog &code, link::symbol_table &symbols);
+};
+}
+#endif
@@ -0,0 +1,336 @@
+#include "peephole.hpp"
+#include <algorithm>
+#include <iterator>
+namespace peephole
+{
+using namespace inst;
+/*
+ * A vector with a gap that follows the position being rewritten, so removing
+ * instructions there does not move the rest of the program.
+ */
+template <typename T>
+class gap_buffer
+{
+	std::vector<T> buf;
+	size_t gap_begin, gap_end;
+	void move_gap(size_t pos)
+	{
+		while (gap_begin > pos)
+			buf[--gap_end] = std::move(buf[--gap_begin]);
+		while (gap_begin < pos)
+			buf[gap_begin++] = std::move(buf[gap_end++]);
+	}
+public:
+	gap_buffer(std::vector<T> &&v = {})
+		: buf(std::move(v)), gap_begin(buf.size()), gap_end(buf.size()) {}
+	size_t size() const
+	{
+		return buf.size() - (gap_end - gap_begin);
+	}
+	T &operator[](size_t i)
+	{
+		return buf[i < gap_begin ? i : i + (gap_end - gap_begin)];
+	}
+	const T &operator[](size_t i) const
+	{
+		return buf[i < gap_begin ? i : i + (gap_end - gap_begin)];
+	}
+	void erase(size_t first, size_t last)
+	{
+		move_gap(first);
+		gap_end += last - first;
+	}
+	std::vector<T> release()
+	{
+		move_gap(size());
+		buf.resize(gap_begin);
+		return std::move(buf);
+	}
+};
+struct context
+{
+	gap_buffer<instruction> code;
+	bool linked;
+	// linked only, one entry per instruction
+	gap_buffer<int> old_addr; // address before optimization
+	gap_buffer<int> reloc; // old address jumped to, -1 if not a jump
+	gap_buffer<int> target_cnt; // jumps landing here
+	context(std::vector<instruction> &&_code, bool _linked)
+		: code(std::move(_code)), linked(_linked) {}
+	size_t new_pos(int addr) const
+	{
+		size_t lo = 0, hi = old_addr.size();
+		while (lo < hi)
+		{
+			size_t mid = (lo + hi) / 2;
+			if (old_addr[mid] < addr)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		return lo;
+	}
+	bool is_jump_pair(size_t pos) const
+	{
+		return linked && pos + 1 < code.size() && reloc[pos] != -1
+			&& code[pos].op == inst_op::AUIPC;
+	}
+	// no jump lands inside code[pos + 1, pos + len)
+	bool free_window(size_t pos, size_t len) const
+	{
+		if (!linked)
+			return true;
+		for (size_t i = pos + 1; i < pos + len; ++i)
+			if (target_cnt[i] != 0)
+				return false;
+		return true;
+	}
+	bool dead_after(size_t pos, int reg) const
+	{
+		for (size_t i = pos + 1; i < code.size(); ++i)
+		{
+			auto &&[r1, r2] = src_regs(code[i]);
+			if (r1 == reg || r2 == reg)
+				return false;
+			if (dst_reg(code[i]) == reg)
+				return true;
+			if (code[i].op == inst_op::BEQ || code[i].op == inst_op::JALR)
+				return false;
+		}
+		return !linked;
+	}
+	void replace(size_t pos, size_t len, std::vector<instruction> &&with)
+	{
+		for (size_t i = 0; i < with.size(); ++i)
+			code[pos + i] = with[i];
+		code.erase(pos + with.size(), pos + len);
+		if (!linked)
+			return;
+		int cnt = 0;
+		for (size_t i = pos; i < pos + len; ++i)
+			cnt += target_cnt[i];
+		target_cnt.erase(pos + with.size(), pos + len);
+		old_addr.erase(pos + with.size(), pos + len);
+		reloc.erase(pos + with.size(), pos + len);
+		for (size_t i = pos; i < pos + with.size(); ++i)
+			target_cnt[i] = 0;
+		if (pos < target_cnt.size())
+			target_cnt[pos] += cnt;
+	}
+};
+bool store_load(context &ctx, size_t pos)
+{
+	const auto st = ctx.code[pos], ld = ctx.code[pos + 1];
+	if (!ctx.free_window(pos, 2)
+			|| st.op != inst_op::SW || ld.op != inst_op::LW
+			|| st.rs1 != ld.rs1 || st.imm != ld.imm)
+		return false;
+	if (ld.rd == st.rs2)
+		ctx.replace(pos, 2, {st});
+	else
+		ctx.replace(pos, 2, {st, inst_reg_2_reg(st.rs2, ld.rd)});
+	return true;
+}
+bool load_load(context &ctx, size_t pos)
+{
+	const auto ld0 = ctx.code[pos], ld1 = ctx.code[pos + 1];
+	if (!ctx.free_window(pos, 2)
+			|| ld0.op != inst_op::LW || ld1.op != inst_op::LW
+			|| ld0.rd == zero || ld0.rd == ld0.rs1
+			|| ld0.rs1 != ld1.rs1 || ld0.imm != ld1.imm)
+		return false;
+	if (ld1.rd == ld0.rd)
+		ctx.replace(pos, 2, {ld0});
+	else
+		ctx.replace(pos, 2, {ld0, inst_reg_2_reg(ld0.rd, ld1.rd)});
+	return true;
+}
+bool store_store(context &ctx, size_t pos)
+{
+	const auto st0 = ctx.code[pos], st1 = ctx.code[pos + 1];
+	if (!ctx.free_window(pos, 2)
+			|| st0.op != inst_op::SW || st1.op != inst_op::SW
+			|| st0.rs1 != st1.rs1 || st0.imm != st1.imm)
+		return false;
+	ctx.replace(pos, 2, {st1});
+	return true;
+}
+bool useless(context &ctx, size_t pos)
+{
+	const auto &x = ctx.code[pos];
+	if (ctx.linked && ctx.reloc[pos] != -1)
+		return false;
+	bool self_move = x.op == inst_op::ADDI && x.rd == x.rs1 && x.imm == 0;
+	if (!self_move && (dst_reg(x) != zero || x.op == inst_op::JALR))
+		return false;
+	ctx.replace(pos, 1, {});
+	return true;
+}
+bool coalesce_move(context &ctx, size_t pos)
+{
+	auto def = ctx.code[pos];
+	const auto mov = ctx.code[pos + 1];
+	int tmp = dst_reg(def);
+	if (!ctx.free_window(pos, 2)
+			|| (tmp != t0 && tmp != t1 && tmp != t2)
+			|| (ctx.linked && ctx.reloc[pos] != -1)
+			|| mov.op != inst_op::ADDI || mov.rs1 != tmp || mov.imm != 0
+			|| mov.rd == tmp || !ctx.dead_after(pos + 1, tmp))
+		return false;
+	def.rd = mov.rd;
+	ctx.replace(pos, 2, {def});
+	return true;
+}
+bool jump_to_next(context &ctx, size_t pos)
+{
+	if (!ctx.is_jump_pair(pos) || ctx.new_pos(ctx.reloc[pos]) != pos + 2)
+		return false;
+	--ctx.target_cnt[pos + 2];
+	ctx.replace(pos, 2, {});
+	return true;
+}
+bool branch_to_next(context &ctx, size_t pos)
+{
+	if (ctx.code[pos].op != inst_op::BEQ
+			|| ctx.new_pos(ctx.reloc[pos]) != pos + 1)
+		return false;
+	--ctx.target_cnt[pos + 1];
+	ctx.replace(pos, 1, {});
+	return true;
+}
+/*
+ * BEQ L; jump X; L: jump Y; X: ...  becomes  BEQ Y; X: ...
+ * as long as nothing else jumps to L and Y is within reach of BEQ.
+ */
+bool branch_over_jump(context &ctx, size_t pos)
+{
+	const size_t branch_reach = 4096 / 4;
+	if (ctx.code[pos].op != inst_op::BEQ
+			|| ctx.new_pos(ctx.reloc[pos]) != pos + 3
+			|| !ctx.is_jump_pair(pos + 1) || !ctx.is_jump_pair(pos + 3)
+			|| ctx.new_pos(ctx.reloc[pos + 1]) != pos + 5
+			|| ctx.target_cnt[pos + 1] != 0 || ctx.target_cnt[pos + 2] != 0
+			|| ctx.target_cnt[pos + 3] != 1 || ctx.target_cnt[pos + 4] != 0)
+		return false;
+	size_t y = ctx.new_pos(ctx.reloc[pos + 3]);
+	if ((y > pos && y < pos + 5)
+			|| (y > pos ? y - pos : pos - y) >= branch_reach)
+		return false;
+	ctx.reloc[pos] = ctx.reloc[pos + 3];
+	ctx.target_cnt[pos + 3] = 0;
+	--ctx.target_cnt[pos + 5];
+	ctx.replace(pos, 5, {ctx.code[pos]});
+	return true;
+}
+bool unreachable(context &ctx, size_t pos)
+{
+	size_t nxt = pos + 2;
+	if (!ctx.is_jump_pair(pos) || nxt >= ctx.code.size()
+			|| ctx.target_cnt[nxt] != 0)
+		return false;
+	size_t len = ctx.is_jump_pair(nxt) ? 2 : 1;
+	if (ctx.reloc[nxt] != -1)
+		--ctx.target_cnt[ctx.new_pos(ctx.reloc[nxt])];
+	ctx.replace(nxt, len, {});
+	return true;
+}
+struct rule
+{
+	const char *name;
+	size_t window;
+	bool linked_only;
+	bool (*apply)(context &, size_t);
+};
+const rule rules[] = {
+	{"store-load forwarding", 2, false, store_load},
+	{"repeated load", 2, false, load_load},
+	{"overwritten store", 2, false, store_store},
+	{"nop or self move", 1, false, useless},
+	{"move into final register", 2, false, coalesce_move},
+	{"jump to next instruction", 2, true, jump_to_next},
+	{"branch to next instruction", 1, true, branch_to_next},
+	{"branch over jump", 5, true, branch_over_jump},
+	{"unreachable after jump", 3, true, unreachable},
+};
+stats::stats() : fired(std::size(rules), 0) {}
+void optimize(context &ctx, stats &st)
+{
+	for (bool changed = true; changed; )
+	{
+		changed = false;
+		for (size_t pos = 0; pos < ctx.code.size(); ++pos)
+			for (size_t r = 0; r < std::size(rules); ++r)
+			{
+				const auto &rl = rules[r];
+				if ((rl.linked_only && !ctx.linked)
+						|| pos + rl.window > ctx.code.size())
+					continue;
+				if (rl.apply(ctx, pos))
+				{
+					++st.fired[r];
+					changed = true;
+					if (pos >= ctx.code.size())
+						break;
+				}
+			}
+	}
+}
+void optimize_block(std::vector<instruction> &code, stats &st)
+{
+	context ctx(std::move(code), false);
+	optimize(ctx, st);
+	code = ctx.code.release();
+}
+void optimize_obj_code(translate::obj_code &code, stats &st)
+{
+	for (auto &[id, block] : code)
+		optimize_block(block.instructions, st);
+}
+void optimize_linked(link::linked_prog &code, stats &st,
+		link::symbol_table *symbols)
+{
+	size_t n = code.size();
+	std::vector<int> old_addr(n), reloc(n, -1), target_cnt(n, 0);
+	for (size_t i = 0; i < n; ++i)
+	{
+		old_addr[i] = i * 4;
+		if (code[i].op == inst_op::BEQ)
+			reloc[i] = i * 4 + code[i].imm;
+		else if (code[i].op == inst_op::AUIPC && i + 1 < n
+				&& code[i + 1].op == inst_op::JALR
+				&& code[i + 1].rs1 == code[i].rd)
+			reloc[i] = i * 4 + code[i].imm + code[i + 1].imm;
+	}
+	for (size_t i = 0; i < n; ++i)
+		if (reloc[i] != -1)
+			++target_cnt[reloc[i] / 4];
+	context ctx(std::move(code), true);
+	ctx.old_addr = std::move(old_addr);
+	ctx.reloc = std::move(reloc);
+	ctx.target_cnt = std::move(target_cnt);
+	optimize(ctx, st);
+	code = ctx.code.release();
+	for (size_t i = 0; i < code.size(); ++i)
+	{
+		if (ctx.reloc[i] == -1)
+			continue;
+		int delta_pc = (int(ctx.new_pos(ctx.reloc[i])) - int(i)) * 4;
+		if (code[i].op == inst_op::BEQ)
+			code[i].imm = delta_pc;
+		else
+		{
+			auto &&[high, low] = split_int32(delta_pc);
+			code[i].imm = high;
+			code[i + 1].imm = low;
+		}
+	}
+	if (symbols != nullptr)
+		for (auto &[id, addr] : *symbols)
+			addr = ctx.new_pos(addr) * 4;
+}
+void print_stats(std::ostream &os, const stats &st)
+{
+	for (size_t r = 0; r < std::size(rules); ++r)
+		os << rules[r].name << ": " << st.fired[r] << '\n';
+}
+}
@@ -0,0 +1,26 @@
+#ifndef PEEPHOLE_HPP
+#define PEEPHOLE_HPP
+#include "link.hpp"
+#include <ostream>
+#include <vector>
+namespace peephole
+{
+struct stats
+{
+	std::vector<long> fired; // indexed like the rule table
+	stats();
+};
+/*
+ * Rewrites short instruction windows with the rules of the rule table until
+ * none applies.  Inside a block t0, t1 and t2 are dead at the end; in linked
+ * code jumps are relocated after instructions are removed, and no window may
+ * extend over a jump target.
+ */
+void optimize_block(std::vector<inst::instruction> &code, stats &st);
+void optimize_obj_code(translate::obj_code &code, stats &st);
+// symbols, if given, are moved along with the code
+void optimize_linked(link::linked_prog &code, stats &st,
+		link::symbol_table *symbols = nullptr);
+void print_stats(std::ostream &os, const stats &st);
+}
+#endif
@@ -0,0 +1,103 @@
+#include "pool.hpp"
+#include <algorithm>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+namespace pool
+{
+unsigned default_threads()
+{
+	return std::max(std::thread::hardware_concurrency(), 1u);
+}
+struct run
+{
+	std::mutex lock;
+	size_t begin, end;
+	bool pop(size_t &index)
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		if (begin == end)
+			return false;
+		index = begin++;
+		return true;
+	}
+	size_t size()
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		return end - begin;
+	}
+};
+// moves the back half of victim to thief, which must be empty
+bool steal(run &victim, run &thief)
+{
+	std::scoped_lock guard(victim.lock, thief.lock);
+	size_t len = victim.end - victim.begin;
+	if (len == 0)
+		return false;
+	thief.end = victim.end;
+	victim.end -= (len + 1) / 2;
+	thief.begin = victim.end;
+	return true;
+}
+void for_each(size_t n, const std::function<void(size_t)> &task,
+		unsigned threads)
+{
+	size_t workers = std::min<size_t>(std::clamp(threads, 1u, MAX_THREADS),
+			n);
+	if (workers <= 1)
+	{
+		for (size_t i = 0; i < n; ++i)
+			task(i);
+		return;
+	}
+	std::vector<run> runs(workers);
+	for (size_t w = 0; w < workers; ++w)
+	{
+		runs[w].begin = n * w / workers;
+		runs[w].end = n * (w + 1) / workers;
+	}
+	std::mutex error_lock;
+	std::exception_ptr error;
+	size_t error_index = n;
+	auto work = [&](size_t w)
+	{
+		for (;;)
+		{
+			size_t i;
+			while (runs[w].pop(i))
+				try
+				{
+					task(i);
+				}
+				catch (...)
+				{
+					std::lock_guard<std::mutex> guard(error_lock);
+					if (i < error_index)
+					{
+						error_index = i;
+						error = std::current_exception();
+					}
+				}
+			size_t victim = w, longest = 0;
+			for (size_t v = 0; v < workers; ++v)
+				if (size_t len = runs[v].size(); v != w && len > longest)
+				{
+					victim = v;
+					longest = len;
+				}
+			if (longest == 0)
+				return;
+			steal(runs[victim], runs[w]);
+		}
+	};
+	std::vector<std::thread> pool;
+	for (size_t w = 1; w < workers; ++w)
+		pool.emplace_back(work, w);
+	work(0);
+	for (auto &t : pool)
+		t.join();
+	if (error)
+		std::rethrow_exception(error);
+}
+}
@@ -0,0 +1,22 @@
+#ifndef POOL_HPP
+#define POOL_HPP
+#include <cstddef>
+#include <functional>
+namespace pool
+{
+// more threads than this are never started
+const unsigned MAX_THREADS = 256;
+// the number of hardware threads, at least 1
+unsigned default_threads();
+/*
+ * Runs task(0) .. task(n - 1) on up to `threads` threads, at most
+ * MAX_THREADS.  Every worker starts with an equal run of indices and takes
+ * from its front; a worker whose run is empty steals the back half of the
+ * longest other run.  All tasks run even if some throw, and the exception of
+ * the lowest index is rethrown afterwards, so errors are the same as running
+ * them in order.
+ */
+void for_each(size_t n, const std::function<void(size_t)> &task,
+		unsigned threads);
+}
+#endif
@@ -0,0 +1,29 @@
+#include "profile.hpp"
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+namespace profile
+{
+counts read_counts(std::istream &is)
+{
+	std::vector<long> values;
+	for (std::string line; std::getline(is, line); )
+	{
+		std::istringstream ss(line);
+		std::string word;
+		ss >> word;
+		if (word == "PRINT")
+			ss >> word;
+		char *end;
+		long val = std::strtol(word.c_str(), &end, 10);
+		if (word.empty() || *end != '\0')
+			continue;
+		values.push_back(val);
+	}
+	counts ret;
+	for (size_t i = 0; i + 1 < values.size(); i += 2)
+		ret[values[i]] += values[i + 1];
+	return ret;
+}
+}
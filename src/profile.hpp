@@ -0,0 +1,21 @@
+#ifndef PROFILE_HPP
+#define PROFILE_HPP
+#include <istream>
+#include <map>
+namespace profile
+{
+using counts = std::map<int, long>; // block id -> times executed
+/*
+ * An instrumented program prints "id count" for every block at EXIT.  The
+ * reader takes the printed values, one per line, either bare or as the
+ * simulator's "PRINT value"; other lines are skipped and repeated ids from
+ * several runs add up.
+ */
+counts read_counts(std::istream &is);
+inline long count_of(const counts &prof, int id)
+{
+	auto it = prof.find(id);
+	return it == prof.end() ? 0 : it->second;
+}
+}
+#endif
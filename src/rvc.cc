@@ -0,0 +1,282 @@
+#include "rvc.hpp"
+#include "isa.hpp"
+namespace rvc
+{
+using namespace inst;
+bool fits(int val, int bits)
+{
+	return val >= -(1 << (bits - 1)) && val < (1 << (bits - 1));
+}
+bool prime(int reg) // x8 to x15, the registers of the 3-bit fields
+{
+	return reg >= 8 && reg < 16;
+}
+uint16_t bits(int val, int hi, int lo)
+{
+	return (val >> lo) & ((1 << (hi - lo + 1)) - 1);
+}
+int sign_extend(int val, int bits)
+{
+	return val << (32 - bits) >> (32 - bits);
+}
+uint16_t c_i(int funct3, int imm, int rd, int quadrant)
+{
+	return funct3 << 13 | bits(imm, 5, 5) << 12 | rd << 7
+		| bits(imm, 4, 0) << 2 | quadrant;
+}
+uint16_t c_r(int funct4, int rd, int rs2)
+{
+	return funct4 << 12 | rd << 7 | rs2 << 2 | 0b10;
+}
+uint16_t c_a(int funct2, int rd, int rs2)
+{
+	return 0b100011 << 10 | (rd - 8) << 7 | funct2 << 5 | (rs2 - 8) << 2 | 0b01;
+}
+uint16_t c_shift(int funct2, int rd, int shamt)
+{
+	return 0b100 << 13 | funct2 << 10 | (rd - 8) << 7 | shamt << 2 | 0b01;
+}
+uint16_t c_lsw(int funct3, int imm, int rs1, int rd)
+{
+	return funct3 << 13 | bits(imm, 5, 3) << 10 | (rs1 - 8) << 7
+		| bits(imm, 2, 2) << 6 | bits(imm, 6, 6) << 5 | (rd - 8) << 2;
+}
+std::optional<uint16_t> compress(const instruction &x)
+{
+	int rd = x.rd, rs1 = x.rs1, rs2 = x.rs2, imm = x.imm;
+	bool sp_offset = imm >= 0 && imm < 256 && imm % 4 == 0;
+	bool reg_offset = imm >= 0 && imm < 128 && imm % 4 == 0;
+	switch (x.op)
+	{
+		case inst_op::ADDI:
+			if (rd == zero)
+				return rs1 == zero && imm == 0
+					? std::optional<uint16_t>(0b01) : std::nullopt;
+			if (imm == 0 && rs1 != zero)
+				return c_r(0b1000, rd, rs1); // C.MV
+			if (rs1 == zero && fits(imm, 6))
+				return c_i(0b010, imm, rd, 0b01); // C.LI
+			if (rs1 == rd && imm != 0 && fits(imm, 6))
+				return c_i(0b000, imm, rd, 0b01); // C.ADDI
+			break;
+		case inst_op::ADD:
+			if (rd == zero)
+				break;
+			if (rs1 == zero && rs2 != zero)
+				return c_r(0b1000, rd, rs2);
+			if (rs2 == zero && rs1 != zero)
+				return c_r(0b1000, rd, rs1);
+			if (rd == rs1 && rs2 != zero)
+				return c_r(0b1001, rd, rs2); // C.ADD
+			if (rd == rs2 && rs1 != zero)
+				return c_r(0b1001, rd, rs1);
+			break;
+		case inst_op::SUB:
+		case inst_op::OR:
+		case inst_op::AND:
+		{
+			int funct2 = x.op == inst_op::SUB ? 0b00
+				: x.op == inst_op::OR ? 0b10 : 0b11;
+			if (rd == rs2 && x.op != inst_op::SUB)
+				std::swap(rs1, rs2);
+			if (rd == rs1 && prime(rd) && prime(rs2))
+				return c_a(funct2, rd, rs2);
+			break;
+		}
+		case inst_op::SLLI:
+			if (rd == rs1 && rd != zero && (imm & 31) != 0)
+				return c_i(0b000, imm & 31, rd, 0b10);
+			break;
+		case inst_op::SRLI:
+		case inst_op::SRAI:
+			if (rd == rs1 && prime(rd) && (imm & 31) != 0)
+				return c_shift(x.op == inst_op::SRLI ? 0b00 : 0b01, rd,
+						imm & 31);
+			break;
+		case inst_op::LUI:
+			if (rd != zero && rd != sp && imm != 0 && fits(imm >> 12, 6))
+				return c_i(0b011, imm >> 12, rd, 0b01);
+			break;
+		case inst_op::LW:
+			if (rs1 == sp && rd != zero && sp_offset)
+				return 0b010 << 13 | bits(imm, 5, 5) << 12 | rd << 7
+					| bits(imm, 4, 2) << 4 | bits(imm, 7, 6) << 2 | 0b10;
+			if (prime(rs1) && prime(rd) && reg_offset)
+				return c_lsw(0b010, imm, rs1, rd);
+			break;
+		case inst_op::SW:
+			if (rs1 == sp && sp_offset)
+				return 0b110 << 13 | bits(imm, 5, 2) << 9
+					| bits(imm, 7, 6) << 7 | rs2 << 2 | 0b10;
+			if (prime(rs1) && prime(rs2) && reg_offset)
+				return c_lsw(0b110, imm, rs1, rs2);
+			break;
+		case inst_op::JAL:
+			if (rd == zero && fits(imm, 12))
+				return 0b101 << 13 | bits(imm, 11, 11) << 12
+					| bits(imm, 4, 4) << 11 | bits(imm, 9, 8) << 9 | bits(imm, 10, 10) << 8
+					| bits(imm, 6, 6) << 7 | bits(imm, 7, 7) << 6
+					| bits(imm, 3, 1) << 3 | bits(imm, 5, 5) << 2 | 0b01;
+			break;
+		case inst_op::BEQ:
+			if (rs1 == zero)
+				std::swap(rs1, rs2);
+			if (rs2 == zero && prime(rs1) && fits(imm, 9))
+				return 0b110 << 13 | bits(imm, 8, 8) << 12
+					| bits(imm, 4, 3) << 10 | (rs1 - 8) << 7 | bits(imm, 7, 6) << 5
+					| bits(imm, 2, 1) << 3 | bits(imm, 5, 5) << 2 | 0b01;
+			break;
+		default:
+			break;
+	}
+	return std::nullopt;
+}
+instruction expand(uint16_t c)
+{
+	int funct3 = c >> 13, quadrant = c & 0b11;
+	int rd = bits(c, 11, 7), rs2 = bits(c, 6, 2);
+	int rd_p = bits(c, 4, 2) + 8, rs1_p = bits(c, 9, 7) + 8;
+	int imm6 = sign_extend(bits(c, 12, 12) << 5 | bits(c, 6, 2), 6);
+	int lsw_imm = bits(c, 12, 10) << 3 | bits(c, 6, 6) << 2
+		| bits(c, 5, 5) << 6;
+	switch (quadrant << 3 | funct3)
+	{
+		case 0b00010:
+			return instruction{inst_op::LW, rs1_p, 0, lsw_imm, rd_p};
+		case 0b00110:
+			return instruction{inst_op::SW, rs1_p, rd_p, lsw_imm, 0};
+		case 0b01000:
+			return instruction{inst_op::ADDI, rd, 0, imm6, rd};
+		case 0b01010:
+			return instruction{inst_op::ADDI, zero, 0, imm6, rd};
+		case 0b01011:
+			if (rd == sp)
+				break;
+			return instruction{inst_op::LUI, 0, 0, imm6 * 4096, rd};
+		case 0b01100:
+			switch (bits(c, 11, 10))
+			{
+				case 0b00:
+				case 0b01:
+					return instruction{bits(c, 11, 10) ? inst_op::SRAI
+						: inst_op::SRLI, rs1_p, 0, imm6 & 31, rs1_p};
+				case 0b11:
+				{
+					// funct2 0b01 is C.XOR, which has no counterpart here
+					const inst_op ops[] = {inst_op::SUB, inst_op::SUB,
+						inst_op::OR, inst_op::AND};
+					int funct2 = bits(c, 6, 5);
+					if (funct2 == 0b01 || bits(c, 12, 12) != 0)
+						break;
+					return instruction{ops[funct2], rs1_p, rd_p, 0, rs1_p};
+				}
+			}
+			break;
+		case 0b01101:
+			return instruction{inst_op::JAL, 0, 0, sign_extend(
+					bits(c, 12, 12) << 11 | bits(c, 11, 11) << 4
+					| bits(c, 10, 9) << 8 | bits(c, 8, 8) << 10
+					| bits(c, 7, 7) << 6 | bits(c, 6, 6) << 7
+					| bits(c, 5, 3) << 1 | bits(c, 2, 2) << 5, 12), zero};
+		case 0b01110:
+			return instruction{inst_op::BEQ, rs1_p, zero, sign_extend(
+					bits(c, 12, 12) << 8 | bits(c, 11, 10) << 3
+					| bits(c, 6, 5) << 6 | bits(c, 4, 3) << 1
+					| bits(c, 2, 2) << 5, 9), 0};
+		case 0b10000:
+			return instruction{inst_op::SLLI, rd, 0, rs2, rd};
+		case 0b10010:
+			return instruction{inst_op::LW, sp, 0, bits(c, 12, 12) << 5
+				| bits(c, 6, 4) << 2 | bits(c, 3, 2) << 6, rd};
+		case 0b10110:
+			return instruction{inst_op::SW, sp, rs2,
+				bits(c, 12, 9) << 2 | bits(c, 8, 7) << 6, 0};
+		case 0b10100:
+			if (rs2 == zero || rd == zero)
+				break;
+			return instruction{inst_op::ADD, bits(c, 12, 12) ? rd : zero,
+				rs2, 0, rd};
+	}
+	throw "Unknown compressed instruction";
+}
+struct item
+{
+	instruction x;
+	int target; // item jumped to, -1 if none
+	int size;
+};
+to_raw::raw_prog assemble(const link::linked_prog &code,
+		link::symbol_table *symbols)
+{
+	std::vector<item> items;
+	std::vector<int> item_of(code.size() + 1), target_pos;
+	for (size_t i = 0; i < code.size(); ++i)
+	{
+		const auto &x = code[i];
+		item_of[i] = items.size();
+		if (x.op == inst_op::AUIPC && i + 1 < code.size()
+				&& code[i + 1].op == inst_op::JALR
+				&& code[i + 1].rs1 == x.rd && code[i + 1].rd == zero)
+		{
+			items.push_back({instruction{inst_op::JAL, 0, 0, 0, zero}, 0, 4});
+			target_pos.push_back(i + (x.imm + code[i + 1].imm) / 4);
+			item_of[++i] = items.size() - 1;
+		}
+		else if (x.op == inst_op::BEQ)
+		{
+			items.push_back({x, 0, 4});
+			target_pos.push_back(i + x.imm / 4);
+		}
+		else
+		{
+			items.push_back({x, -1, compress(x) ? 2 : 4});
+			target_pos.push_back(-1);
+		}
+	}
+	item_of[code.size()] = items.size();
+	for (size_t k = 0; k < items.size(); ++k)
+		if (target_pos[k] != -1)
+			items[k].target = item_of[target_pos[k]];
+	std::vector<int> addr(items.size() + 1);
+	for (bool changed = true; changed; )
+	{
+		changed = false;
+		for (size_t k = 0; k < items.size(); ++k)
+			addr[k + 1] = addr[k] + items[k].size;
+		for (size_t k = 0; k < items.size(); ++k)
+		{
+			auto &it = items[k];
+			if (it.target == -1 || it.size == 2)
+				continue;
+			it.x.imm = addr[it.target] - addr[k];
+			if (compress(it.x))
+			{
+				it.size = 2;
+				changed = true;
+			}
+		}
+	}
+	to_raw::raw_prog ret;
+	for (size_t k = 0; k < items.size(); ++k)
+	{
+		auto &it = items[k];
+		if (it.target != -1)
+			it.x.imm = addr[it.target] - addr[k];
+		uint32_t raw;
+		if (it.size == 2)
+			raw = *compress(it.x);
+		else
+		{
+			if (it.x.op == inst_op::JAL && !fits(it.x.imm, 21))
+				throw "Jump out of range.";
+			raw = isa::encode(it.x);
+		}
+		for (int j = 0; j < it.size; ++j, raw >>= 8)
+			ret.push_back(raw & 0xff);
+	}
+	if (symbols != nullptr)
+		for (auto &[id, pos] : *symbols)
+			pos = addr[item_of[pos / 4]];
+	return ret;
+}
+}
@@ -0,0 +1,21 @@
+#ifndef RVC_HPP
+#define RVC_HPP
+#include "to_raw.hpp"
+#include <cstdint>
+#include <optional>
+namespace rvc
+{
+// the 16-bit form of x, if it has one; branch and jump offsets are in x.imm
+std::optional<uint16_t> compress(const inst::instruction &x);
+// inverse of compress, throws on forms compress does not produce
+inst::instruction expand(uint16_t c);
+/*
+ * Encodes linked code with compressed instructions wherever they are legal.
+ * Jump pairs become JAL, and jumps and branches shrink to C.J and C.BEQZ
+ * while their offsets fit, which is iterated since every shrink brings
+ * other targets closer.  Symbols are moved to the new addresses.
+ */
+to_raw::raw_prog assemble(const link::linked_prog &code,
+		link::symbol_table *symbols = nullptr);
+}
+#endif
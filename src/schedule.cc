@@ -0,0 +1,190 @@
+#include "schedule.hpp"
+#include <algorithm>
+namespace schedule
+{
+using namespace inst;
+struct latency_entry
+{
+	inst_op op;
+	int cycles; // until the result can be used without stalling
+};
+const latency_entry latency_table[] = {
+	{inst_op::LW, 2},
+	{inst_op::MUL, 3},
+	{inst_op::MULH, 3},
+	{inst_op::DIV, 3},
+};
+const int BRANCH_PENALTY = 2;
+latency_model default_model()
+{
+	latency_model ret;
+	for (const auto &[op, cycles] : latency_table)
+		ret.latency[op] = cycles;
+	ret.branch_penalty = BRANCH_PENALTY;
+	return ret;
+}
+struct dep_graph
+{
+	// succ[i] holds {j, cycles}: j issues at least cycles after i
+	std::vector<std::vector<std::pair<size_t, int>>> succ;
+	std::vector<int> pred_cnt;
+	dep_graph(size_t n) : succ(n), pred_cnt(n, 0) {}
+	void add(size_t from, size_t to, int cycles)
+	{
+		succ[from].emplace_back(to, cycles);
+		++pred_cnt[to];
+	}
+};
+// address relative to sp if x accesses a variable slot
+bool slot_address(const instruction &x, int &addr)
+{
+	if (x.rs1 == sp)
+	{
+		addr = x.imm;
+		return true;
+	}
+	for (size_t i = 0; i < std::size(far_base_reg); ++i)
+		if (x.rs1 == far_base_reg[i])
+		{
+			addr = x.imm + 4096 * int(i + 1);
+			return true;
+		}
+	return false;
+}
+dep_graph build_deps(const std::vector<instruction> &code,
+		const latency_model &model)
+{
+	dep_graph g(code.size());
+	std::vector<int> last_def(REAL_REG, -1);
+	std::vector<std::vector<size_t>> readers(REAL_REG);
+	std::map<int, std::vector<size_t>> mem_ops; // by slot address
+	std::vector<size_t> all_mem_ops, unknown_mem_ops;
+	int barrier = -1;
+	for (size_t i = 0; i < code.size(); ++i)
+	{
+		const auto &x = code[i];
+		if (x.op == inst_op::ECALL)
+		{
+			for (size_t j = barrier + 1; j < i; ++j)
+				g.add(j, i, 1);
+			barrier = i;
+		}
+		else if (barrier != -1)
+			g.add(barrier, i, 1);
+		auto &&[r1, r2] = src_regs(x);
+		for (int r : {r1, r2})
+			if (r > 0 && last_def[r] != -1)
+				g.add(last_def[r], i,
+						model.latency_of(code[last_def[r]].op));
+		int rd = dst_reg(x);
+		if (rd > 0)
+		{
+			for (size_t j : readers[rd])
+				if (j != i)
+					g.add(j, i, 1);
+			if (last_def[rd] != -1)
+				g.add(last_def[rd], i, 1);
+		}
+		for (int r : {r1, r2})
+			if (r > 0)
+				readers[r].push_back(i);
+		if (rd > 0)
+		{
+			last_def[rd] = i;
+			readers[rd].clear();
+		}
+		if (x.op != inst_op::LW && x.op != inst_op::SW)
+			continue;
+		int addr;
+		bool known = slot_address(x, addr);
+		if (known && mem_ops.count(addr) == 0)
+			mem_ops[addr] = unknown_mem_ops;
+		const auto &others = known ? mem_ops[addr] : all_mem_ops;
+		for (size_t j : others)
+			if (x.op == inst_op::SW || code[j].op == inst_op::SW)
+				g.add(j, i, 1);
+		if (known)
+			mem_ops[addr].push_back(i);
+		else
+		{
+			for (auto &[a, ops] : mem_ops)
+				ops.push_back(i);
+			unknown_mem_ops.push_back(i);
+		}
+		all_mem_ops.push_back(i);
+	}
+	return g;
+}
+void schedule_block(std::vector<instruction> &code,
+		const latency_model &model, int branch_reg)
+{
+	size_t n = code.size();
+	auto &&g = build_deps(code, model);
+	std::vector<int> height(n, 1);
+	for (size_t i = n; i-- > 0; )
+	{
+		if (dst_reg(code[i]) == branch_reg)
+			height[i] = std::max(height[i], model.latency_of(code[i].op));
+		for (auto &[j, cycles] : g.succ[i])
+			height[i] = std::max(height[i], cycles + height[j]);
+	}
+	std::vector<long> ready(n, 0);
+	std::vector<size_t> cand;
+	for (size_t i = 0; i < n; ++i)
+		if (g.pred_cnt[i] == 0)
+			cand.push_back(i);
+	std::vector<instruction> ret;
+	long cycle = 0;
+	while (!cand.empty())
+	{
+		auto better = [&](size_t a, size_t b)
+		{
+			bool ra = ready[a] <= cycle, rb = ready[b] <= cycle;
+			if (ra != rb)
+				return ra;
+			if (!ra && ready[a] != ready[b])
+				return ready[a] < ready[b];
+			if (height[a] != height[b])
+				return height[a] > height[b];
+			return a < b;
+		};
+		auto best = std::min_element(cand.begin(), cand.end(), better);
+		size_t i = *best;
+		cand.erase(best);
+		cycle = std::max(cycle, ready[i]);
+		ret.push_back(code[i]);
+		for (auto &[j, cycles] : g.succ[i])
+		{
+			ready[j] = std::max(ready[j], cycle + cycles);
+			if (--g.pred_cnt[j] == 0)
+				cand.push_back(j);
+		}
+		++cycle;
+	}
+	code = std::move(ret);
+}
+void schedule_obj_code(translate::obj_code &code, const latency_model &model)
+{
+	for (auto &[id, block] : code)
+		schedule_block(block.instructions, model,
+				block.condition == nullptr ? -1 : a0);
+}
+long estimate_cycles(const std::vector<instruction> &code,
+		const latency_model &model, bool ends_in_jump)
+{
+	std::vector<long> avail(REAL_REG, 0);
+	long cycle = 0;
+	for (const auto &x : code)
+	{
+		auto &&[r1, r2] = src_regs(x);
+		for (int r : {r1, r2})
+			if (r > 0)
+				cycle = std::max(cycle, avail[r]);
+		int rd = dst_reg(x);
+		if (rd > 0)
+			avail[rd] = cycle + model.latency_of(x.op);
+		++cycle;
+	}
+	return cycle + (ends_in_jump ? model.branch_penalty : 0);
+}
+}
@@ -0,0 +1,31 @@
+#ifndef SCHEDULE_HPP
+#define SCHEDULE_HPP
+#include "translate.hpp"
+#include <map>
+#include <vector>
+namespace schedule
+{
+struct latency_model
+{
+	std::map<inst::inst_op, int> latency; // ops not listed take 1 cycle
+	int branch_penalty; // extra cycles of a taken branch or jump
+	int latency_of(inst::inst_op op) const
+	{
+		auto it = latency.find(op);
+		return it == latency.end() ? 1 : it->second;
+	}
+};
+latency_model default_model();
+/*
+ * Reorders the instructions of a block so that results are used as late as
+ * the dependences allow, most critical path first.  branch_reg is read by the
+ * branch that follows the block, -1 if there is none.
+ */
+void schedule_block(std::vector<inst::instruction> &code,
+		const latency_model &model, int branch_reg);
+void schedule_obj_code(translate::obj_code &code, const latency_model &model);
+// cycles to run the block once on an in-order pipeline, taken branch included
+long estimate_cycles(const std::vector<inst::instruction> &code,
+		const latency_model &model, bool ends_in_jump);
+}
+#endif
@@ -0,0 +1,101 @@
+#include "server.hpp"
+#include "channel.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <iterator>
+#include <sstream>
+#include <thread>
+#include <vector>
+namespace server
+{
+const char STOP[] = "--stop-server";
+// for a client to send its request, and again to take the answer
+const std::chrono::seconds IO_TIMEOUT(10);
+// answers one request; returns true if it asks the server to stop
+bool handle(channel::connection &conn, const driver::settings &base)
+{
+	std::string options, source;
+	conn.set_timeout(IO_TIMEOUT);
+	if (!conn.recv_frame(options) || !conn.recv_frame(source))
+		return false;
+	auto s = base;
+	std::istringstream args(options);
+	std::ostringstream os, log;
+	bool ok = true, stop = false;
+	try
+	{
+		for (std::string arg; args >> arg; )
+			if (arg == STOP)
+				stop = true;
+			else if (!driver::parse_option(arg, s))
+				throw "Unknown option in request.";
+		if (!stop)
+		{
+			std::istringstream is(source);
+			driver::compile(is, os, log, s);
+		}
+	}
+	catch (const char *e)
+	{
+		ok = false;
+		log << e << '\n';
+	}
+	catch (const std::exception &e)
+	{
+		ok = false;
+		log << e.what() << '\n';
+	}
+	conn.set_timeout(IO_TIMEOUT);
+	conn.send_frame(ok ? "ok" : "error") && conn.send_frame(os.str())
+		&& conn.send_frame(log.str());
+	return stop;
+}
+void serve(const std::string &path, const driver::settings &s,
+		unsigned threads)
+{
+	channel::listener listener(path);
+	std::atomic<bool> stopping = false;
+	auto work = [&]
+	{
+		while (!stopping)
+		{
+			int fd = listener.accept();
+			if (fd < 0)
+				return;
+			channel::connection conn(fd);
+			if (handle(conn, s))
+			{
+				stopping = true;
+				// wakes the workers blocked in accept
+				listener.shutdown();
+			}
+		}
+	};
+	std::vector<std::thread> workers;
+	for (unsigned i = 1; i < std::max(threads, 1u); ++i)
+		workers.emplace_back(work);
+	work();
+	for (auto &t : workers)
+		t.join();
+}
+bool request(const std::string &path, const std::string &options,
+		std::istream &is, std::ostream &os, std::ostream &log)
+{
+	// read first, so the server is not kept waiting on a slow input
+	std::string source;
+	if (options.find(STOP) == std::string::npos)
+		source.assign(std::istreambuf_iterator<char>(is),
+				std::istreambuf_iterator<char>());
+	channel::connection conn(channel::connect(path));
+	std::string status, output, diagnostics;
+	if (!conn.send_frame(options) || !conn.send_frame(source)
+			|| !conn.recv_frame(status) || !conn.recv_frame(output)
+			|| !conn.recv_frame(diagnostics))
+		throw "Lost connection to server.";
+	os.write(output.data(), output.size());
+	log << diagnostics << std::flush;
+	return status == "ok";
+}
+}
@@ -0,0 +1,23 @@
+#ifndef SERVER_HPP
+#define SERVER_HPP
+#include "driver.hpp"
+#include <istream>
+#include <ostream>
+#include <string>
+namespace server
+{
+/*
+ * Every message is a sequence of frames, a 32-bit length in host order and
+ * that many bytes.  A request is the options (driver::parse_option ones,
+ * separated by spaces) and the source; the answer is "ok" or "error", the
+ * output and the diagnostics.  The option --stop-server ends the server.
+ */
+// Serves requests on the UNIX socket at path with `threads` workers, each
+// compiling with s changed by the options of the request.
+void serve(const std::string &path, const driver::settings &s,
+		unsigned threads);
+// Compiles the program in is on the server at path; returns false on error.
+bool request(const std::string &path, const std::string &options,
+		std::istream &is, std::ostream &os, std::ostream &log);
+}
+#endif
@@ -0,0 +1,139 @@
+#include "strength.hpp"
+#include <bit>
+#include <cstdint>
+namespace strength
+{
+using namespace inst;
+const size_t MAX_MUL_SEQ = 3; // a MUL and the stall on its result
+// x * v for v = 2^a or 2^a +- 2^b
+bool shift_add(int x, uint32_t v, int ans, std::vector<instruction> &seq)
+{
+	if (std::popcount(v) == 1)
+	{
+		int a = std::countr_zero(v);
+		seq.push_back(a == 0 ? inst_reg_2_reg(x, ans)
+				: instruction{inst_op::SLLI, x, 0, a, ans});
+		return true;
+	}
+	int b = std::countr_zero(v), a;
+	inst_op op;
+	if (std::popcount(v) == 2)
+	{
+		a = 31 - std::countl_zero(v);
+		op = inst_op::ADD;
+	}
+	else if (uint32_t w = v + (1u << b); std::popcount(w) == 1)
+	{
+		a = std::countr_zero(w);
+		op = inst_op::SUB;
+	}
+	else
+		return false;
+	seq.push_back(instruction{inst_op::SLLI, x, 0, a - b, t1});
+	seq.push_back(instruction{op, t1, x, 0, b == 0 ? ans : t1});
+	if (b != 0)
+		seq.push_back(instruction{inst_op::SLLI, t1, 0, b, ans});
+	return true;
+}
+bool mul_by_imm(int x, int imm, int ans, std::vector<instruction> &out)
+{
+	if (imm == 0)
+	{
+		out.push_back(instruction{inst_op::ADDI, zero, 0, 0, ans});
+		return true;
+	}
+	for (bool negate : {false, true})
+	{
+		std::vector<instruction> seq;
+		if (!shift_add(x, negate ? -uint32_t(imm) : uint32_t(imm), ans, seq))
+			continue;
+		if (negate)
+			seq.push_back(instruction{inst_op::SUB, zero, ans, 0, ans});
+		if (seq.size() <= MAX_MUL_SEQ)
+		{
+			out.insert(out.end(), seq.begin(), seq.end());
+			return true;
+		}
+	}
+	return false;
+}
+// magic number and shift for 2 <= |d| < 2^31, from Hacker's Delight 10-1
+std::pair<int, int> magic(int d)
+{
+	const uint32_t two31 = 0x80000000u;
+	uint32_t ad = d < 0 ? -uint32_t(d) : d;
+	uint32_t t = two31 + (uint32_t(d) >> 31);
+	uint32_t anc = t - 1 - t % ad;
+	uint32_t q1 = two31 / anc, r1 = two31 - q1 * anc;
+	uint32_t q2 = two31 / ad, r2 = two31 - q2 * ad, delta;
+	int p = 31;
+	do
+	{
+		++p;
+		q1 *= 2;
+		r1 *= 2;
+		if (r1 >= anc)
+		{
+			++q1;
+			r1 -= anc;
+		}
+		q2 *= 2;
+		r2 *= 2;
+		if (r2 >= ad)
+		{
+			++q2;
+			r2 -= ad;
+		}
+		delta = ad - r2;
+	} while (q1 < delta || (q1 == delta && r1 == 0));
+	int m = q2 + 1;
+	return {d < 0 ? -m : m, p - 32};
+}
+bool div_by_imm(int x, int imm, int ans, std::vector<instruction> &out)
+{
+	if (imm == 0)
+		return false;
+	if (imm == 1 || imm == -1)
+	{
+		out.push_back(imm == 1 ? inst_reg_2_reg(x, ans)
+				: instruction{inst_op::SUB, zero, x, 0, ans});
+		return true;
+	}
+	uint32_t abs_imm = imm < 0 ? -uint32_t(imm) : imm;
+	if (std::popcount(abs_imm) == 1)
+	{
+		// round towards zero: add 2^k - 1 to negative dividends first
+		int k = std::countr_zero(abs_imm);
+		if (k == 1)
+			out.push_back(instruction{inst_op::SRLI, x, 0, 31, t1});
+		else
+			out.insert(out.end(), {
+				instruction{inst_op::SRAI, x, 0, 31, t1},
+				instruction{inst_op::SRLI, t1, 0, 32 - k, t1}
+			});
+		out.insert(out.end(), {
+			instruction{inst_op::ADD, t1, x, 0, t1},
+			instruction{inst_op::SRAI, t1, 0, k, ans}
+		});
+		if (imm < 0)
+			out.push_back(instruction{inst_op::SUB, zero, ans, 0, ans});
+		return true;
+	}
+	auto &&[m, shift] = magic(imm);
+	auto &&load = inst_load_imm(m, t1);
+	out.insert(out.end(), load.begin(), load.end());
+	out.push_back(instruction{inst_op::MULH, t1, x, 0, t1});
+	if (imm > 0 && m < 0)
+		out.push_back(instruction{inst_op::ADD, t1, x, 0, t1});
+	else if (imm < 0 && m > 0)
+		out.push_back(instruction{inst_op::SUB, t1, x, 0, t1});
+	if (shift != 0)
+		out.push_back(instruction{inst_op::SRAI, t1, 0, shift, t1});
+	// add one to negative quotients
+	out.insert(out.end(), {
+		instruction{inst_op::SRLI, t1, 0, 31, ans},
+		instruction{inst_op::ADD, ans, t1, 0, ans}
+	});
+	return true;
+}
+}
@@ -0,0 +1,15 @@
+#ifndef STRENGTH_HPP
+#define STRENGTH_HPP
+#include "inst.hpp"
+#include <vector>
+namespace strength
+{
+/*
+ * Append code computing x * imm (x / imm, truncating) into ans without MUL
+ * (DIV), and return false if there is no cheaper sequence.  x must be a real
+ * register; it may equal ans.  t1 is clobbered.
+ */
+bool mul_by_imm(int x, int imm, int ans, std::vector<inst::instruction> &out);
+bool div_by_imm(int x, int imm, int ans, std::vector<inst::instruction> &out);
+}
+#endif
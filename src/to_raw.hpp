@@ -8,5 +8,8 @@ namespace to_raw
 using raw_prog = std::vector<uint8_t>;
 raw_prog to_raw_prog(const link::linked_prog &code);
 void print_raw_prog(std::ostream &os, const raw_prog &prog);
+// same output as print_raw_prog, encoded straight into a fixed buffer
+void write_hex(std::ostream &os, const link::linked_prog &code);
+void write_hex(std::ostream &os, const raw_prog &prog);
 }
 #endif
@@ -1,28 +1,121 @@
 #include "translate.hpp"
+#include "pool.hpp"
+#include "strength.hpp"
+#include <type_traits>
 #include <typeinfo>
+#include <algorithm>
 namespace translate
 {
 using namespace inst;
-struct virtual_reg
+const int PINNED_REG_BEGIN = 20;
+struct var_layout
 {
-	int virtual_reg_cnt, memory_reg_end;
-	std::set<int> aval_reg;
+	int memory_reg_end = REAL_REG; // end of variable slots
+	std::set<int> pinned_reg;
 	std::map<std::string, int> reg_map;
-	virtual_reg() : virtual_reg_cnt(REAL_REG), memory_reg_end(REAL_REG)
-	{
-		for (int i = 10; i < REAL_REG; ++i)
-			aval_reg.insert(i);
-	}
+	std::map<int, int> const_reg; // constant -> pinned register, set on entry
 	int preserve_var(const std::string &var_name, int elements)
 	{
 		if (reg_map.count(var_name) != 0)
 			return reg_map[var_name];
 		int ret = memory_reg_end;
 		reg_map[var_name] = memory_reg_end;
-		virtual_reg_cnt += elements;
 		memory_reg_end += elements;
 		return ret;
 	}
+	void pin_var(const std::string &var_name, int reg)
+	{
+		pinned_reg.insert(reg);
+		reg_map[var_name] = reg;
+	}
+	int location(const std::string &var_name) const
+	{
+		auto it = reg_map.find(var_name);
+		if (it == reg_map.end())
+			throw "Unknown identifier.";
+		return it->second;
+	}
+	// var is a variable or an element at a constant index
+	int location(const expr::expr &var) const
+	{
+		if (typeid(var) == typeid(expr::id))
+			return location(static_cast<const expr::id&>(var).id_name);
+		const auto &sub = static_cast<const expr::subscript&>(var);
+		return location(static_cast<const expr::id&>(*sub.lc).id_name)
+			+ static_cast<const expr::imm_num&>(*sub.rc).value;
+	}
+};
+// true if e lives in a slot known at compile time
+bool fixed_slot(const expr::expr &e)
+{
+	return typeid(e) == typeid(expr::id)
+		|| (typeid(e) == typeid(expr::subscript) && typeid(*static_cast
+				<const expr::subscript&>(e).rc) == typeid(expr::imm_num));
+}
+// true if v fits the 12-bit immediate of ADDI, SLTI and the like
+bool fits_imm(long v)
+{
+	return v >= -2048 && v < 2048;
+}
+// e as x op imm for one immediate instruction (two for some comparisons)
+struct imm_form
+{
+	const std::unique_ptr<expr::expr> *x = nullptr; // nullptr if there is none
+	int imm; // the immediate of the instruction
+	expr::cmp::cmp_op op; // comparisons, turned around if the constant is left
+};
+imm_form fold_imm(const expr::expr &e)
+{
+	const auto &type = typeid(e);
+	imm_form ret;
+	if (type != typeid(expr::add) && type != typeid(expr::sub)
+			&& type != typeid(expr::cmp))
+		return ret;
+	const auto &op = static_cast<const expr::bin_op&>(e);
+	bool left = typeid(*op.lc) == typeid(expr::imm_num);
+	if (left ? type == typeid(expr::sub)
+			: typeid(*op.rc) != typeid(expr::imm_num))
+		return ret;
+	long k = static_cast<const expr::imm_num&>(left ? *op.lc : *op.rc).value;
+	if (type == typeid(expr::sub))
+		k = -k;
+	else if (type == typeid(expr::cmp))
+	{
+		using expr::cmp;
+		const cmp::cmp_op turned[] = {cmp::GT, cmp::GE, cmp::LT, cmp::LE,
+			cmp::EQ, cmp::NE};
+		ret.op = static_cast<const cmp&>(e).op;
+		if (left)
+			ret.op = turned[ret.op];
+		// x <= k is x < k + 1, x == k is x - k == 0
+		if (ret.op == cmp::LE || ret.op == cmp::GT)
+			++k;
+		else if (ret.op == cmp::EQ || ret.op == cmp::NE)
+			k = -k;
+	}
+	if (!fits_imm(k))
+		return ret;
+	ret.x = left ? &op.rc : &op.lc;
+	ret.imm = k;
+	return ret;
+}
+// Registers and spill slots of one block; every block starts from the same
+// state, so blocks are translated independently of each other.
+struct virtual_reg
+{
+	const var_layout &layout;
+	int virtual_reg_cnt; // end of all slots
+	std::set<int> aval_reg;
+	std::map<const expr::expr *, int> need_cache;
+	std::set<int> repeated; // large constants read more than once
+	std::map<int, int> const_reg; // constant -> register until the block ends
+	virtual_reg(const var_layout &_layout)
+		: layout(_layout), virtual_reg_cnt(_layout.memory_reg_end)
+	{
+		for (int i = 10; i < REAL_REG; ++i)
+			if (layout.pinned_reg.count(i) == 0)
+				aval_reg.insert(i);
+	}
 	void preserve_reg(int reg)
 	{
 		aval_reg.erase(reg);
@@ -30,18 +123,472 @@ struct virtual_reg
 	int allocate_reg()
 	{
 		if (aval_reg.empty())
-			return ++virtual_reg_cnt;
+			return virtual_reg_cnt++;
 		int ret = *aval_reg.begin();
 		preserve_reg(ret);
 		return ret;
 	}
 	void deallocate_reg(int reg)
 	{
-		if ((reg >= 10 && reg < REAL_REG) || reg > memory_reg_end)
+		if (layout.pinned_reg.count(reg) != 0)
+			return;
+		for (const auto &[value, kept] : const_reg)
+			if (kept == reg)
+				return;
+		if ((reg >= 10 && reg < REAL_REG) || reg >= layout.memory_reg_end)
 			aval_reg.insert(reg);
 	}
 };
+bool has_imm_operand(const expr::bin_op &e, const std::type_info &type)
+{
+	if (type == typeid(expr::mul))
+		return typeid(*e.lc) == typeid(expr::imm_num)
+			|| typeid(*e.rc) == typeid(expr::imm_num);
+	return type == typeid(expr::div) && typeid(*e.rc) == typeid(expr::imm_num);
+}
+// true if strength turns e, a product or quotient by a constant, into shifts
+bool strength_lowers(const expr::bin_op &e, const std::type_info &type)
+{
+	if (!has_imm_operand(e, type))
+		return false;
+	bool is_div = type == typeid(expr::div);
+	bool imm_left = !is_div && typeid(*e.lc) == typeid(expr::imm_num);
+	int imm = static_cast<const expr::imm_num&>(imm_left ? *e.lc : *e.rc).value;
+	std::vector<instruction> seq;
+	return is_div ? strength::div_by_imm(t0, imm, t2, seq)
+		: strength::mul_by_imm(t0, imm, t2, seq);
+}
+// Adds weight to every constant of e that takes LUI to load and is not
+// folded into an instruction.
+void count_constants(const expr::expr &e, long weight,
+		std::map<int, long> &cnt)
+{
+	const auto &type = typeid(e);
+	if (fixed_slot(e))
+		return;
+	if (type == typeid(expr::imm_num))
+	{
+		int value = static_cast<const expr::imm_num&>(e).value;
+		if (!fits_imm(value))
+			cnt[value] += weight;
+	}
+	else if (type == typeid(expr::neg))
+		count_constants(*static_cast<const expr::neg&>(e).c, weight, cnt);
+	else if (type == typeid(expr::subscript))
+		count_constants(*static_cast<const expr::subscript&>(e).rc, weight,
+				cnt);
+	else
+	{
+		const auto &op = static_cast<const expr::bin_op&>(e);
+		bool lowered = strength_lowers(op, type);
+		if (!lowered || typeid(*op.lc) != typeid(expr::imm_num))
+			count_constants(*op.lc, weight, cnt);
+		if (!lowered || typeid(*op.rc) != typeid(expr::imm_num))
+			count_constants(*op.rc, weight, cnt);
+	}
+}
+// Adds weight to every variable and array e reads or stores.
+void count_accesses(const expr::expr &e, long weight,
+		std::map<std::string, long> &cnt)
+{
+	const auto &type = typeid(e);
+	if (type == typeid(expr::id))
+		cnt[static_cast<const expr::id&>(e).id_name] += weight;
+	else if (type == typeid(expr::neg))
+		count_accesses(*static_cast<const expr::neg&>(e).c, weight, cnt);
+	else if (type != typeid(expr::imm_num))
+	{
+		count_accesses(*static_cast<const expr::bin_op&>(e).lc, weight, cnt);
+		count_accesses(*static_cast<const expr::bin_op&>(e).rc, weight, cnt);
+	}
+}
+// Calls f on every expression sent reads and every variable it assigns.
+template <class F>
+void for_each_expr(const statement::statement &sent, F f)
+{
+	const auto &type = typeid(sent);
+	const statement::assignment *assign = nullptr;
+	if (type == typeid(statement::LET))
+		assign = &static_cast<const statement::LET&>(sent).assign;
+	else if (type == typeid(statement::END_FOR))
+		assign = &static_cast<const statement::END_FOR&>(sent).step_statement;
+	else if (type == typeid(statement::INPUT))
+		for (const auto &var :
+				static_cast<const statement::INPUT&>(sent).inputs)
+			f(*var);
+	else if (type == typeid(statement::EXIT))
+		f(*static_cast<const statement::EXIT&>(sent).val);
+	else if (type == typeid(statement::IF))
+		f(*static_cast<const statement::IF&>(sent).condition);
+	else if (type == typeid(statement::FOR))
+		f(*static_cast<const statement::FOR&>(sent).condition);
+	if (assign != nullptr)
+	{
+		f(*assign->var);
+		f(*assign->val);
+	}
+}
+const long LOOP_WEIGHT = 10; // runs of a loop body assumed without a profile
+// how often each block is expected to run: its count in the profile if there
+// is one, else LOOP_WEIGHT to the power of its loop depth
+std::map<int, long> block_weights(const basic_block::cfg_type &cfg,
+		const options &opt)
+{
+	std::map<int, long> ret;
+	for (const auto &[line, block] : cfg)
+	{
+		long &w = ret[line] = 1;
+		if (opt.prof != nullptr)
+			w += profile::count_of(*opt.prof, line);
+		else if (opt.loop_depth != nullptr && opt.loop_depth->count(line) != 0)
+			for (int i = 0; i < std::min(opt.loop_depth->at(line), 4); ++i)
+				w *= LOOP_WEIGHT;
+	}
+	return ret;
+}
+/*
+ * Large constants read more than once (weighted by block_weights) go to the
+ * pinned registers hidden variables left free, most read first, and are
+ * loaded once on entry instead of each time.
+ */
+void pin_constants(const basic_block::cfg_type &cfg,
+		const std::map<int, long> &weight, var_layout &regs)
+{
+	std::map<int, long> cnt;
+	for (const auto &[line, block] : cfg)
+		for (const auto &sent : block.commands)
+			for_each_expr(*sent, [&](const expr::expr &e)
+			{
+				count_constants(e, weight.at(line), cnt);
+			});
+	std::vector<std::pair<long, int>> order;
+	for (const auto &[value, n] : cnt)
+		if (n > 1)
+			order.emplace_back(-n, value);
+	std::sort(order.begin(), order.end());
+	int reg = REAL_REG - 1;
+	for (const auto &[n, value] : order)
+	{
+		while (reg >= PINNED_REG_BEGIN && regs.pinned_reg.count(reg) != 0)
+			--reg;
+		if (reg < PINNED_REG_BEGIN)
+			break;
+		regs.pinned_reg.insert(reg);
+		regs.const_reg[value] = reg;
+	}
+}
+/*
+ * Variables, and the slots hidden variables share, are laid out most accessed
+ * first, by block_weights, so that the hot ones share the first cache lines
+ * and the short offsets from sp while cold ones go past NEAR_SLOTS, behind
+ * the far base registers; arrays follow them.  Hidden variables are colored
+ * into the pinned registers, most accessed first, then into the shared
+ * slots, and constants take the pinned registers left.  Without
+ * opt.interference all of it is skipped: every variable gets a slot of its
+ * own, in order of appearance.
+ */
+void layout_vars(const basic_block::cfg_type &cfg, var_layout &regs,
+		const options &opt)
+{
+	const auto *arrays = opt.arrays;
+	bool weighted = opt.interference != nullptr;
+	std::vector<std::string> named, hidden;
+	std::set<std::string> seen;
+	std::map<std::string, long> access;
+	std::map<int, long> weight;
+	if (weighted)
+		weight = block_weights(cfg, opt);
+	for (const auto &[line, block] : cfg)
+		for (const auto &sent : block.commands)
+		{
+			long w = weighted ? weight.at(line) : 1;
+			for_each_expr(*sent, [&](const expr::expr &e)
+			{
+				count_accesses(e, w, access);
+			});
+			const auto &type = typeid(*sent);
+			const std::unique_ptr<expr::expr> *var = nullptr;
+			if (type == typeid(statement::LET))
+				var = &static_cast<statement::LET&>(*sent).assign.var;
+			else if (type == typeid(statement::END_FOR))
+				var = &static_cast<statement::END_FOR&>(*sent)
+					.step_statement.var;
+			if (var != nullptr && typeid(**var) == typeid(expr::id))
+			{
+				const auto &name = static_cast<expr::id&>(**var).id_name;
+				if (expr::is_hidden_id(name))
+					hidden.push_back(name);
+				else if (seen.insert(name).second)
+					named.push_back(name);
+			}
+			if (type == typeid(statement::INPUT))
+				for (const auto &input :
+						static_cast<statement::INPUT&>(*sent).inputs)
+					if (typeid(*input) == typeid(expr::id) && seen.insert
+							(static_cast<expr::id&>(*input).id_name).second)
+						named.push_back
+							(static_cast<expr::id&>(*input).id_name);
+		}
+	// a variable that is only read keeps the 0 of its slot, as when run by
+	// interp or jit
+	for (const auto &[name, n] : access)
+		if (!expr::is_hidden_id(name) && seen.count(name) == 0
+				&& (arrays == nullptr || arrays->count(name) == 0))
+			named.push_back(name);
+	if (!weighted)
+	{
+		for (const auto &name : named)
+			regs.preserve_var(name, 1);
+		for (const auto &name : hidden)
+			regs.preserve_var(name, 1);
+		if (arrays != nullptr)
+			for (const auto &[name, size] : *arrays)
+				regs.preserve_var(name, size);
+		return;
+	}
+	const auto &interference = *opt.interference;
+	auto by_access = [&access](const std::string &a, const std::string &b)
+	{
+		return access[a] > access[b];
+	};
+	std::stable_sort(hidden.begin(), hidden.end(), by_access);
+	// a pinned register, or -1 - k for shared slot k
+	std::map<std::string, int> color;
+	std::vector<long> shared_access;
+	for (const auto &name : hidden)
+	{
+		std::set<int> used;
+		auto it = interference.find(name);
+		if (it != interference.end())
+			for (const auto &v : it->second)
+				if (color.count(v) != 0)
+					used.insert(color[v]);
+		int loc = REAL_REG - 1;
+		while (loc >= PINNED_REG_BEGIN && used.count(loc) != 0)
+			--loc;
+		if (loc >= PINNED_REG_BEGIN)
+		{
+			regs.pin_var(name, loc);
+			color[name] = loc;
+			continue;
+		}
+		size_t k = 0;
+		while (used.count(-1 - int(k)) != 0)
+			++k;
+		color[name] = -1 - int(k);
+		if (k == shared_access.size())
+			shared_access.push_back(0);
+		shared_access[k] += access[name];
+	}
+	// access and index, counting named variables, then shared slots
+	std::vector<std::pair<long, size_t>> order;
+	for (size_t i = 0; i < named.size(); ++i)
+		order.emplace_back(access[named[i]], i);
+	for (size_t k = 0; k < shared_access.size(); ++k)
+		order.emplace_back(shared_access[k], named.size() + k);
+	std::stable_sort(order.begin(), order.end(),
+			[](const auto &a, const auto &b)
+			{
+				return a.first > b.first;
+			});
+	std::vector<int> shared_slot(shared_access.size());
+	for (const auto &[n, i] : order)
+		if (i < named.size())
+			regs.preserve_var(named[i], 1);
+		else
+			shared_slot[i - named.size()] = regs.memory_reg_end++;
+	for (const auto &[name, loc] : color)
+		if (loc < 0)
+			regs.reg_map[name] = shared_slot[-1 - loc];
+	if (arrays != nullptr)
+	{
+		std::vector<std::string> names;
+		for (const auto &[name, size] : *arrays)
+			names.push_back(name);
+		std::stable_sort(names.begin(), names.end(), by_access);
+		for (const auto &name : names)
+			regs.preserve_var(name, arrays->at(name));
+	}
+	pin_constants(cfg, weight, regs);
+}
 const int UNDETERMINED_REG = -1;
+// Sethi-Ullman number: registers needed to evaluate e without spilling.
+int reg_need(const std::unique_ptr<expr::expr> &e, virtual_reg &regs)
+{
+	auto it = regs.need_cache.find(e.get());
+	if (it != regs.need_cache.end())
+		return it->second;
+	const auto &type = typeid(*e);
+	int ret;
+	if (fixed_slot(*e))
+		ret = 0;
+	else if (type == typeid(expr::neg))
+		ret = std::max(1, reg_need(static_cast<expr::neg&>(*e).c, regs));
+	else if (type == typeid(expr::subscript))
+		ret = std::max(1, reg_need(static_cast<expr::subscript&>(*e).rc, regs));
+	else if (type == typeid(expr::imm_num))
+		ret = 1;
+	else if (fold_imm(*e).x != nullptr)
+		ret = std::max(1, reg_need(*fold_imm(*e).x, regs));
+	else
+	{
+		const auto &bin_expr = static_cast<expr::bin_op&>(*e);
+		int l = reg_need(bin_expr.lc, regs), r = reg_need(bin_expr.rc, regs);
+		ret = std::max(1, l == r ? l + 1 : std::max(l, r));
+	}
+	return regs.need_cache[e.get()] = ret;
+}
+using convert_func = std::vector<instruction> (*)
+	(const std::unique_ptr<expr::expr> &, int &, virtual_reg &);
+// Evaluates the operand needing more registers first; on return both lhs and
+// rhs are real registers and have been released.
+std::vector<instruction>
+convert_operands(const expr::bin_op &bin_expr, convert_func convert,
+		int &lhs, int &rhs, virtual_reg &regs)
+{
+	lhs = rhs = UNDETERMINED_REG;
+	std::vector<instruction> ret, ret_second;
+	if (reg_need(bin_expr.rc, regs) > reg_need(bin_expr.lc, regs))
+	{
+		ret = convert(bin_expr.rc, rhs, regs);
+		ret_second = convert(bin_expr.lc, lhs, regs);
+	}
+	else
+	{
+		ret = convert(bin_expr.lc, lhs, regs);
+		ret_second = convert(bin_expr.rc, rhs, regs);
+	}
+	ret.insert(ret.end(), ret_second.begin(), ret_second.end());
+	if (lhs >= REAL_REG)
+	{
+		ret.push_back(inst_mem_2_reg(lhs, t0));
+		regs.deallocate_reg(lhs);
+		lhs = t0;
+	}
+	if (rhs >= REAL_REG)
+	{
+		ret.push_back(inst_mem_2_reg(rhs, t1));
+		regs.deallocate_reg(rhs);
+		rhs = t1;
+	}
+	regs.deallocate_reg(lhs);
+	regs.deallocate_reg(rhs);
+	return ret;
+}
+std::vector<instruction>
+convert_val_expr(const std::unique_ptr<expr::expr> &e, int &target,
+		virtual_reg &regs);
+// Appends code evaluating e to a real register (t0 if e is in memory), and
+// returns the register, released.
+int convert_to_reg(const std::unique_ptr<expr::expr> &e, virtual_reg &regs,
+		std::vector<instruction> &code)
+{
+	int x = UNDETERMINED_REG;
+	auto &&ret = convert_val_expr(e, x, regs);
+	code.insert(code.end(), ret.begin(), ret.end());
+	if (x >= REAL_REG)
+	{
+		code.push_back(inst_mem_2_reg(x, t0));
+		regs.deallocate_reg(x);
+		x = t0;
+	}
+	regs.deallocate_reg(x);
+	return x;
+}
+const size_t MIN_FREE_REG = 6; // left to expressions by the constant cache
+/*
+ * A register holding the large constant value, or UNDETERMINED_REG if value
+ * is to be loaded where it is used.  A constant the block reads again is
+ * loaded into a register of its own on first use, which stays reserved until
+ * the block ends, as long as enough registers remain; the highest ones are
+ * taken, clear of a0 and a1.
+ */
+int constant_reg(int value, virtual_reg &regs, std::vector<instruction> &code)
+{
+	auto it = regs.layout.const_reg.find(value);
+	if (it != regs.layout.const_reg.end())
+		return it->second;
+	it = regs.const_reg.find(value);
+	if (it != regs.const_reg.end())
+		return it->second;
+	if (regs.repeated.count(value) == 0
+			|| regs.aval_reg.size() <= MIN_FREE_REG)
+		return UNDETERMINED_REG;
+	int reg = *regs.aval_reg.rbegin();
+	regs.preserve_reg(reg);
+	regs.const_reg[value] = reg;
+	auto &&load = inst_load_imm(value, reg);
+	code.insert(code.end(), load.begin(), load.end());
+	return reg;
+}
+// x * imm or x / imm, with shifts and adds where strength can lower it
+std::vector<instruction>
+convert_by_imm(const expr::bin_op &bin_expr, bool is_div, int &target,
+		int &ans, virtual_reg &regs)
+{
+	bool imm_left = !is_div && typeid(*bin_expr.lc) == typeid(expr::imm_num);
+	int imm = static_cast<const expr::imm_num&>
+		(imm_left ? *bin_expr.lc : *bin_expr.rc).value;
+	std::vector<instruction> ret;
+	// taken before x is released, so the two do not share a register
+	int y = UNDETERMINED_REG;
+	if (!fits_imm(imm) && !strength_lowers(bin_expr, typeid(bin_expr)))
+		y = constant_reg(imm, regs, ret);
+	int x = convert_to_reg(imm_left ? bin_expr.rc : bin_expr.lc, regs, ret);
+	if (target == UNDETERMINED_REG)
+	{
+		target = regs.allocate_reg();
+		if (target < REAL_REG)
+			ans = target;
+	}
+	std::vector<instruction> seq;
+	if (is_div ? strength::div_by_imm(x, imm, ans, seq)
+			: strength::mul_by_imm(x, imm, ans, seq))
+		ret.insert(ret.end(), seq.begin(), seq.end());
+	else
+	{
+		if (y == UNDETERMINED_REG)
+		{
+			auto &&load = inst_load_imm(imm, t1);
+			ret.insert(ret.end(), load.begin(), load.end());
+			y = t1;
+		}
+		ret.push_back(instruction{is_div ? inst_op::DIV : inst_op::MUL,
+				x, y, 0, ans});
+	}
+	return ret;
+}
+/*
+ * Leaves in t0 the address of element e less slot_offset(mem); a constant
+ * term of the index goes to mem, as long as that is a slot.
+ */
+std::vector<instruction>
+element_address(const expr::subscript &e, int &mem, virtual_reg &regs)
+{
+	mem = regs.layout.location(static_cast<const expr::id&>(*e.lc).id_name);
+	const auto *dyn = &e.rc;
+	if (typeid(*e.rc) == typeid(expr::add))
+	{
+		const auto &sum = static_cast<const expr::add&>(*e.rc);
+		if (typeid(*sum.rc) == typeid(expr::imm_num))
+		{
+			long slot = long(mem) + static_cast<const expr::imm_num&>
+				(*sum.rc).value;
+			if (slot >= REAL_REG && slot < regs.layout.memory_reg_end)
+			{
+				mem = slot;
+				dyn = &sum.lc;
+			}
+		}
+	}
+	std::vector<instruction> ret;
+	int x = convert_to_reg(*dyn, regs, ret);
+	ret.insert(ret.end(), {
+		instruction{inst_op::SLLI, x, 0, 2, t0},
+		instruction{inst_op::ADD, t0, slot_base(mem), 0, t0}
+	});
+	return ret;
+}
 std::vector<instruction>
 convert_val_expr(const std::unique_ptr<expr::expr> &e, int &target,
 		virtual_reg &regs)
@@ -51,19 +598,22 @@ convert_val_expr(const std::unique_ptr<expr::expr> &e, int &target,
 			type == typeid(expr::bool_and) ||
 			type == typeid(expr::bool_or))
 		throw "Error when convert_val_expr: get bool expr where val expr is expected.";
-	else if (type == typeid(expr::subscript))
-		throw "subscript is not supported yet.";
-	if (type == typeid(expr::id))
+	if (fixed_slot(*e))
 	{
-		const auto &var = static_cast<expr::id&>(*e).id_name;
-		if (regs.reg_map.count(var) == 0)
-			throw "Unknown identifier.";
-		int mem_addr = regs.reg_map[var];
-		if (target == UNDETERMINED_REG)
+		int mem_addr = regs.layout.location(*e);
+		if (target == UNDETERMINED_REG || target == mem_addr)
 		{
 			target = mem_addr;
 			return {};
 		}
+		else if (mem_addr < REAL_REG)
+		{
+			regs.preserve_reg(target);
+			if (target < REAL_REG)
+				return { inst_reg_2_reg(mem_addr, target) };
+			else
+				return { inst_reg_2_mem(mem_addr, target) };
+		}
 		else
 		{
 			regs.preserve_reg(target);
@@ -80,15 +630,18 @@ convert_val_expr(const std::unique_ptr<expr::expr> &e, int &target,
 	std::vector<instruction> ret;
 	if (type == typeid(expr::imm_num))
 	{
-		const int &imm = static_cast<expr::imm_num&>(*e).value;
-		auto &&[high, low] = split_int32(imm);
-		if (high != 0)
-			ret = {
-				instruction{inst_op::LUI, 0, 0, high, ans},
-				instruction{inst_op::ADDI, ans, 0, low, ans}
-			};
+		int value = static_cast<expr::imm_num&>(*e).value;
+		int reg = fits_imm(value)
+			? UNDETERMINED_REG : constant_reg(value, regs, ret);
+		if (reg == UNDETERMINED_REG)
+			ret = inst_load_imm(value, ans);
+		else if (target == UNDETERMINED_REG)
+		{
+			target = reg;
+			return ret;
+		}
 		else
-			ret = {instruction{inst_op::ADDI, zero, 0, low, ans}};
+			ans = reg;
 	}
 	else if (type == typeid(expr::neg))
 	{
@@ -96,24 +649,43 @@ convert_val_expr(const std::unique_ptr<expr::expr> &e, int &target,
 		ret = convert_val_expr(neg_expr.c, ans, regs);
 		ret.push_back(instruction{inst_op::SUB, zero, ans, 0, ans});
 	}
-	else
+	else if (type == typeid(expr::subscript))
 	{
-		const auto &bin_expr = static_cast<expr::bin_op&>(*e);
-		int lhs = UNDETERMINED_REG, rhs = UNDETERMINED_REG;
-		ret = convert_val_expr(bin_expr.lc, lhs, regs);
-		auto &&ret_rhs = convert_val_expr(bin_expr.rc, rhs, regs);
-		ret.insert(ret.end(), ret_rhs.begin(), ret_rhs.end());
-		if (lhs >= REAL_REG)
+		int mem;
+		ret = element_address(static_cast<expr::subscript&>(*e), mem, regs);
+		if (target == UNDETERMINED_REG)
 		{
-			ret.push_back(inst_mem_2_reg(lhs, t0));
-			regs.deallocate_reg(lhs);
-			lhs = t0;
+			target = regs.allocate_reg();
+			if (target < REAL_REG)
+				ans = target;
 		}
-		if (rhs >= REAL_REG)
+		ret.push_back(instruction{inst_op::LW, t0, 0, slot_offset(mem), ans});
+	}
+	else if (fold_imm(*e).x != nullptr)
+	{
+		auto &&f = fold_imm(*e);
+		int x = convert_to_reg(*f.x, regs, ret);
+		if (target == UNDETERMINED_REG)
 		{
-			ret.push_back(inst_mem_2_reg(rhs, t1));
-			regs.deallocate_reg(rhs);
-			rhs = t1;
+			target = regs.allocate_reg();
+			if (target < REAL_REG)
+				ans = target;
+		}
+		ret.push_back(instruction{inst_op::ADDI, x, 0, f.imm, ans});
+	}
+	else if (has_imm_operand(static_cast<expr::bin_op&>(*e), type))
+		ret = convert_by_imm(static_cast<expr::bin_op&>(*e),
+				type == typeid(expr::div), target, ans, regs);
+	else
+	{
+		const auto &bin_expr = static_cast<expr::bin_op&>(*e);
+		int lhs, rhs;
+		ret = convert_operands(bin_expr, convert_val_expr, lhs, rhs, regs);
+		if (target == UNDETERMINED_REG)
+		{
+			target = regs.allocate_reg();
+			if (target < REAL_REG)
+				ans = target;
 		}
 		if (type == typeid(expr::add))
 			ret.push_back(instruction{inst_op::ADD, lhs, rhs, 0, ans});
@@ -123,8 +695,6 @@ convert_val_expr(const std::unique_ptr<expr::expr> &e, int &target,
 			ret.push_back(instruction{inst_op::MUL, lhs, rhs, 0, ans});
 		else if (type == typeid(expr::div))
 			ret.push_back(instruction{inst_op::DIV, lhs, rhs, 0, ans});
-		regs.deallocate_reg(lhs);
-		regs.deallocate_reg(rhs);
 	}
 	if (ans != target)
 	{
@@ -144,37 +714,44 @@ convert_bool_expr(const std::unique_ptr<expr::expr> &e, int &target,
 {
 	int ans = (target >= 0 && target < REAL_REG ? target : t2);
 	const auto &type = typeid(*e);
+	if (type == typeid(expr::id)
+			&& expr::is_hidden_id(static_cast<expr::id&>(*e).id_name))
+		return convert_val_expr(e, target, regs);
 	if (type != typeid(expr::cmp)
 			&& type != typeid(expr::bool_and)
 			&& type != typeid(expr::bool_or))
 		throw "Error when convert_bool_expr: get val expr where bool expr is expected.";
 	const auto &bin_expr = static_cast<expr::bin_op&>(*e);
-	std::vector<instruction> ret, ret_rhs;
-	int lhs = UNDETERMINED_REG, rhs = UNDETERMINED_REG;
-	if (type == typeid(expr::cmp))
-	{
-		ret = convert_val_expr(bin_expr.lc, lhs, regs);
-		ret_rhs = convert_val_expr(bin_expr.rc, rhs, regs);
-	}
+	auto &&f = fold_imm(*e);
+	int lhs, rhs;
+	std::vector<instruction> ret;
+	if (f.x != nullptr)
+		lhs = convert_to_reg(*f.x, regs, ret);
 	else
+		ret = convert_operands(bin_expr, type == typeid(expr::cmp)
+				? convert_val_expr : convert_bool_expr, lhs, rhs, regs);
+	if (target == UNDETERMINED_REG)
 	{
-		ret = convert_bool_expr(bin_expr.lc, lhs, regs);
-		ret_rhs = convert_bool_expr(bin_expr.rc, rhs, regs);
+		target = regs.allocate_reg();
+		if (target < REAL_REG)
+			ans = target;
 	}
-	ret.insert(ret.end(), ret_rhs.begin(), ret_rhs.end());
-	if (lhs >= REAL_REG)
+	if (f.x != nullptr)
 	{
-		ret.push_back(inst_mem_2_reg(lhs, t0));
-		regs.deallocate_reg(lhs);
-		lhs = t0;
-	}
-	if (rhs >= REAL_REG)
-	{
-		ret.push_back(inst_mem_2_reg(rhs, t1));
-		regs.deallocate_reg(rhs);
-		rhs = t1;
+		if (f.op != expr::cmp::EQ && f.op != expr::cmp::NE)
+			ret.push_back(instruction{inst_op::SLTI, lhs, 0, f.imm, ans});
+		else if (f.imm == 0)
+			ret.push_back(instruction{inst_op::SLTIU, lhs, 0, 1, ans});
+		else
+			ret.insert(ret.end(), {
+				instruction{inst_op::ADDI, lhs, 0, f.imm, ans},
+				instruction{inst_op::SLTIU, ans, 0, 1, ans}
+			});
+		if (f.op == expr::cmp::GE || f.op == expr::cmp::GT
+				|| f.op == expr::cmp::NE)
+			ret.push_back(instruction{inst_op::XORI, ans, 0, 1, ans});
 	}
-	if (type == typeid(expr::cmp))
+	else if (type == typeid(expr::cmp))
 	{
 		const auto &cmp_expr = static_cast<expr::cmp&>(*e);
 		switch (cmp_expr.op)
@@ -206,8 +783,6 @@ convert_bool_expr(const std::unique_ptr<expr::expr> &e, int &target,
 		ret.push_back(instruction{inst_op::AND, lhs, rhs, 0, ans});
 	else
 		ret.push_back(instruction{inst_op::OR, lhs, rhs, 0, ans});
-	regs.deallocate_reg(lhs);
-	regs.deallocate_reg(rhs);
 	if (ans != target)
 	{
 		if (target == UNDETERMINED_REG)
@@ -220,102 +795,345 @@ convert_bool_expr(const std::unique_ptr<expr::expr> &e, int &target,
 	regs.preserve_reg(target);
 	return ret;
 }
-obj_code translate_to_obj_code(const basic_block::cfg_type &cfg)
+std::vector<instruction>
+convert_assign(const statement::assignment &assign, virtual_reg &regs)
 {
-	virtual_reg reg_map;
-	obj_code ret;
-	for (const auto &[line, block] : cfg)
+	const auto &var = *assign.var;
+	if (!fixed_slot(var))
 	{
-		std::vector<instruction> inst;
-		for (const auto &sent : block.commands)
+		if (typeid(var) != typeid(expr::subscript))
+			throw "lvalue expected in {LET} command.";
+		int v = UNDETERMINED_REG, mem;
+		auto &&ret = convert_val_expr(assign.val, v, regs);
+		auto &&addr = element_address
+			(static_cast<const expr::subscript&>(var), mem, regs);
+		ret.insert(ret.end(), addr.begin(), addr.end());
+		if (v >= REAL_REG)
 		{
-			const auto &type = typeid(*sent);
-			std::vector<instruction> sent_inst;
-			if (type == typeid(statement::LET))
-			{
-				const auto &assign =
-					static_cast<statement::LET&>(*sent).assign;
-				if (typeid(*(assign.val)) == typeid(expr::subscript))
-					throw "subscript is not supported yet.";
-				if (typeid(*(assign.var)) != typeid(expr::id))
-					throw "lvalue expected in {LET} command.";
-				int mem_reg = reg_map.preserve_var
-					(static_cast<expr::id&>(*(assign.var)).id_name, 1);
-				sent_inst = convert_val_expr(assign.val, mem_reg, reg_map);
-			}
-			else if (type == typeid(statement::INPUT))
+			ret.push_back(inst_mem_2_reg(v, t1));
+			regs.deallocate_reg(v);
+			v = t1;
+		}
+		regs.deallocate_reg(v);
+		ret.push_back(instruction{inst_op::SW, t0, v, slot_offset(mem), 0});
+		return ret;
+	}
+	int mem_reg = regs.layout.location(var);
+	const auto &val_type = typeid(*(assign.val));
+	if (typeid(var) == typeid(expr::id)
+			&& expr::is_hidden_id(static_cast<const expr::id&>(var).id_name)
+			&& (val_type == typeid(expr::cmp)
+				|| val_type == typeid(expr::bool_and)
+				|| val_type == typeid(expr::bool_or)))
+		return convert_bool_expr(assign.val, mem_reg, regs);
+	return convert_val_expr(assign.val, mem_reg, regs);
+}
+// Prints the id and counter of every block, clobbering a0 and a1.
+std::vector<instruction> dump_counters(const std::map<int, int> &counter)
+{
+	std::vector<instruction> ret
+		= {instruction{inst_op::ADDI, zero, 0, CALL_PRINT, a0}};
+	for (const auto &[line, slot] : counter)
+	{
+		auto &&load = inst_load_imm(line, a1);
+		ret.insert(ret.end(), load.begin(), load.end());
+		ret.insert(ret.end(), {
+			instruction{inst_op::ECALL, 0, 0, 0, 0},
+			inst_mem_2_reg(slot, a1),
+			instruction{inst_op::ECALL, 0, 0, 0, 0}
+		});
+	}
+	return ret;
+}
+// Translates one block; slot_end is raised to cover the slots it uses.
+std::vector<instruction> translate_block(int line,
+		const basic_block::basic_block_type &block, const var_layout &layout,
+		const std::map<int, int> &counter, int &slot_end)
+{
+	virtual_reg reg_map(layout);
+	std::map<int, long> constants;
+	for (const auto &sent : block.commands)
+		for_each_expr(*sent, [&constants](const expr::expr &e)
+		{
+			count_constants(e, 1, constants);
+		});
+	for (const auto &[value, n] : constants)
+		if (n > 1)
+			reg_map.repeated.insert(value);
+	std::vector<instruction> inst;
+	if (!counter.empty())
+		inst = {
+			inst_mem_2_reg(counter.at(line), t0),
+			instruction{inst_op::ADDI, t0, 0, 1, t0},
+			inst_reg_2_mem(t0, counter.at(line))
+		};
+	for (const auto &sent : block.commands)
+	{
+		const auto &type = typeid(*sent);
+		std::vector<instruction> sent_inst;
+		if (type == typeid(statement::LET))
+			sent_inst = convert_assign
+				(static_cast<statement::LET&>(*sent).assign, reg_map);
+		else if (type == typeid(statement::INPUT))
+		{
+			const auto &inputs =
+				static_cast<statement::INPUT&>(*sent).inputs;
+			for (const auto &var : inputs)
 			{
-				const auto &inputs =
-					static_cast<statement::INPUT&>(*sent).inputs;
-				for (const auto &var : inputs)
+				const auto &type_var = typeid(*var);
+				instruction store;
+				if (fixed_slot(*var))
+					store = inst_reg_2_mem(a0, layout.location(*var));
+				else if (type_var == typeid(expr::subscript))
 				{
-					const auto &type_var = typeid(*var);
-					if (type_var == typeid(expr::subscript))
-						throw "subscript is not supported yet.";
-					if (type_var != typeid(expr::id))
-						throw "lvalue expected in {INPUT} command.";
-					const auto &name = static_cast<expr::id&>(*var).id_name;
-					auto mem_reg = reg_map.preserve_var(name, 1);
-					sent_inst.insert(sent_inst.end(), {
-						instruction{inst_op::ADDI, zero, 0, CALL_READ, a0},
-						instruction{inst_op::ECALL, 0, 0, 0, 0},
-						inst_reg_2_mem(a0, mem_reg)
-					});
+					int mem;
+					auto &&addr = element_address
+						(static_cast<expr::subscript&>(*var), mem, reg_map);
+					sent_inst.insert(sent_inst.end(), addr.begin(), addr.end());
+					store = instruction{inst_op::SW, t0, a0,
+						slot_offset(mem), 0};
 				}
-			}
-			else if (type == typeid(statement::EXIT))
-			{
-				int exit_val_reg = a1;
-				sent_inst = convert_val_expr
-					(static_cast<statement::EXIT&>(*sent).val,
-						exit_val_reg, reg_map);
+				else
+					throw "lvalue expected in {INPUT} command.";
 				sent_inst.insert(sent_inst.end(), {
-					instruction{inst_op::ADDI, zero, 0, CALL_EXIT, a0},
-					instruction{inst_op::ECALL, 0, 0, 0, 0}
+					instruction{inst_op::ADDI, zero, 0, CALL_READ, a0},
+					instruction{inst_op::ECALL, 0, 0, 0, 0},
+					store
 				});
-				reg_map.deallocate_reg(a1);
-			}
-			else if (type == typeid(statement::IF))
-			{
-				int branch_flag = a0;
-				sent_inst = convert_bool_expr
-					(static_cast<statement::IF&>(*sent).condition,
-						branch_flag, reg_map);
-				reg_map.deallocate_reg(a0);
-			}
-			else if (type == typeid(statement::FOR))
-			{
-				int branch_flag = a0;
-				sent_inst = convert_bool_expr
-					(static_cast<statement::FOR&>(*sent).condition,
-						branch_flag, reg_map);
-				reg_map.deallocate_reg(a0);
 			}
-			else if (type == typeid(statement::END_FOR))
+		}
+		else if (type == typeid(statement::EXIT))
+		{
+			int exit_val_reg = a1;
+			if (!counter.empty())
 			{
-				const auto &assign =
-					static_cast<statement::END_FOR&>(*sent).step_statement;
-				if (typeid(*(assign.val)) == typeid(expr::subscript))
-					throw "subscript is not supported yet.";
-				if (typeid(*(assign.var)) != typeid(expr::id))
-					throw "lvalue expected in {LET} command.";
-				int mem_reg = reg_map.preserve_var
-					(static_cast<expr::id&>(*(assign.var)).id_name, 1);
-				sent_inst = convert_val_expr(assign.val, mem_reg, reg_map);
+				auto &&dump = dump_counters(counter);
+				inst.insert(inst.end(), dump.begin(), dump.end());
 			}
-			else
+			sent_inst = convert_val_expr
+				(static_cast<statement::EXIT&>(*sent).val,
+					exit_val_reg, reg_map);
+			sent_inst.insert(sent_inst.end(), {
+				instruction{inst_op::ADDI, zero, 0, CALL_EXIT, a0},
+				instruction{inst_op::ECALL, 0, 0, 0, 0}
+			});
+			reg_map.deallocate_reg(a1);
+		}
+		else if (type == typeid(statement::IF))
+		{
+			int branch_flag = a0;
+			sent_inst = convert_bool_expr
+				(static_cast<statement::IF&>(*sent).condition,
+					branch_flag, reg_map);
+			reg_map.deallocate_reg(a0);
+		}
+		else if (type == typeid(statement::FOR))
+		{
+			int branch_flag = a0;
+			sent_inst = convert_bool_expr
+				(static_cast<statement::FOR&>(*sent).condition,
+					branch_flag, reg_map);
+			reg_map.deallocate_reg(a0);
+		}
+		else if (type == typeid(statement::END_FOR))
+			sent_inst = convert_assign(static_cast<statement::END_FOR&>(*sent)
+					.step_statement, reg_map);
+		else
+		{
+		}
+		inst.insert(inst.end(), sent_inst.begin(), sent_inst.end());
+	}
+	slot_end = std::max(slot_end, reg_map.virtual_reg_cnt);
+	return inst;
+}
+// every node starts with its tag, so no two trees hash the same bytes
+enum node_tag { ID_NODE, NUM_NODE, NEG_NODE, OP_NODE };
+void hash_expr(const expr::expr &e, const var_layout &layout,
+		cache::digest &h)
+{
+	const auto &type = typeid(e);
+	if (type == typeid(expr::id))
+	{
+		// unknown names are left for translate_block to report
+		const auto &name = static_cast<const expr::id&>(e).id_name;
+		auto it = layout.reg_map.find(name);
+		h.add(ID_NODE);
+		h.add(name);
+		h.add(it == layout.reg_map.end() ? -1 : it->second);
+	}
+	else if (type == typeid(expr::imm_num))
+	{
+		h.add(NUM_NODE);
+		h.add(static_cast<const expr::imm_num&>(e).value);
+	}
+	else if (type == typeid(expr::neg))
+	{
+		h.add(NEG_NODE);
+		hash_expr(*static_cast<const expr::neg&>(e).c, layout, h);
+	}
+	else
+	{
+		const auto &op = static_cast<const expr::bin_op&>(e);
+		h.add(OP_NODE);
+		h.add(op.op_name());
+		hash_expr(*op.lc, layout, h);
+		hash_expr(*op.rc, layout, h);
+	}
+}
+const char *const CACHE_VERSION = "translate 3"; // bump with codegen changes
+// what every block shares: spill slots, pinned registers, constants in them
+// and counters
+cache::digest hash_layout(const var_layout &layout,
+		const std::map<int, int> &counter)
+{
+	cache::digest h;
+	h.add(CACHE_VERSION);
+	h.add(layout.memory_reg_end);
+	h.add(layout.pinned_reg.size());
+	for (int reg : layout.pinned_reg)
+		h.add(reg);
+	h.add(layout.const_reg.size());
+	for (const auto &[value, reg] : layout.const_reg)
+	{
+		h.add(value);
+		h.add(reg);
+	}
+	h.add(counter.size());
+	for (const auto &[id, slot] : counter)
+	{
+		h.add(id);
+		h.add(slot);
+	}
+	return h;
+}
+// everything else translate_block depends on
+cache::key block_key(const basic_block::basic_block_type &block,
+		const var_layout &layout, const std::map<int, int> &counter,
+		int line, cache::digest h)
+{
+	if (!counter.empty())
+		h.add(counter.at(line));
+	h.add(block.commands.size());
+	for (const auto &sent : block.commands)
+	{
+		const auto &type = typeid(*sent);
+		h.add(type.name());
+		bool let = type == typeid(statement::LET);
+		if (let || type == typeid(statement::END_FOR))
+		{
+			const auto &assign = let
+				? static_cast<statement::LET&>(*sent).assign
+				: static_cast<statement::END_FOR&>(*sent).step_statement;
+			hash_expr(*assign.var, layout, h);
+			hash_expr(*assign.val, layout, h);
+		}
+		else if (type == typeid(statement::INPUT))
+		{
+			const auto &inputs = static_cast<statement::INPUT&>(*sent).inputs;
+			h.add(inputs.size());
+			for (const auto &var : inputs)
+				hash_expr(*var, layout, h);
+		}
+		else if (type == typeid(statement::EXIT))
+			hash_expr(*static_cast<statement::EXIT&>(*sent).val, layout, h);
+		else if (type == typeid(statement::IF))
+			hash_expr(*static_cast<statement::IF&>(*sent).condition,
+					layout, h);
+		else if (type == typeid(statement::FOR))
+			hash_expr(*static_cast<statement::FOR&>(*sent).condition,
+					layout, h);
+	}
+	return h.value();
+}
+// With a mutable cfg the statements of each block are freed once it is
+// translated, and its condition is moved instead of copied.
+template <class CFG>
+obj_code translate_cfg(CFG &cfg, const options &opt)
+{
+	constexpr bool consume = !std::is_const_v<CFG>;
+	var_layout layout;
+	obj_code ret;
+	layout_vars(cfg, layout, opt);
+	std::map<int, int> counter;
+	if (opt.instrument)
+		for (const auto &[line, block] : cfg)
+			counter[line] = layout.preserve_var
+				("#count" + std::to_string(line), 1);
+	cache::digest shared;
+	if (opt.cache != nullptr)
+		shared = hash_layout(layout, counter);
+	std::vector<decltype(&*cfg.begin())> blocks;
+	for (auto &entry : cfg)
+		blocks.push_back(&entry);
+	std::vector<std::vector<instruction>> code(blocks.size());
+	std::vector<int> slot_ends(blocks.size(), layout.memory_reg_end);
+	pool::for_each(blocks.size(), [&](size_t i)
+	{
+		auto &[line, block] = *blocks[i];
+		if (opt.cache == nullptr)
+			code[i] = translate_block(line, block, layout, counter,
+					slot_ends[i]);
+		else
+		{
+			auto &&key = block_key(block, layout, counter, line, shared);
+			if (!opt.cache->load(key, code[i], slot_ends[i]))
 			{
+				code[i] = translate_block(line, block, layout, counter,
+						slot_ends[i]);
+				opt.cache->save(key, code[i], slot_ends[i]);
 			}
-			inst.insert(inst.end(), sent_inst.begin(), sent_inst.end());
 		}
-		ret.emplace(line, obj_code_block(std::move(inst),
-				block.condition == nullptr
-					? nullptr
-					: block.condition->deep_copy(),
-				block.jump_true, block.jump_false));
+		if constexpr (consume)
+			block.commands.clear();
+		// the entry block waits for the prologue
+		if (opt.finish_block && i != 0)
+			opt.finish_block(code[i], block.condition != nullptr);
+	}, opt.jobs);
+	int slot_end = *std::max_element(slot_ends.begin(), slot_ends.end());
+	for (size_t i = 0; i < blocks.size(); ++i)
+	{
+		auto &[line, block] = *blocks[i];
+		std::unique_ptr<expr::expr> condition;
+		if constexpr (consume)
+			condition = std::move(block.condition);
+		else if (block.condition != nullptr)
+			condition = block.condition->deep_copy();
+		ret.emplace(line, obj_code_block(std::move(code[i]),
+				std::move(condition), block.jump_true, block.jump_false));
+	}
+	if (slot_end - REAL_REG > MAX_SLOTS)
+		throw "Too many variables.";
+	ret.slots = slot_end - REAL_REG;
+	std::vector<instruction> prologue;
+	for (int i = 0; i <= far_base_idx(slot_end - 1); ++i)
+		prologue.insert(prologue.end(), {
+			instruction{inst_op::LUI, 0, 0, 4096 * (i + 1), far_base_reg[i]},
+			instruction{inst_op::ADD, far_base_reg[i], sp, 0, far_base_reg[i]}
+		});
+	for (const auto &[value, reg] : layout.const_reg)
+	{
+		auto &&load = inst_load_imm(value, reg);
+		prologue.insert(prologue.end(), load.begin(), load.end());
 	}
+	auto &entry = ret.begin()->second;
+	entry.instructions.insert(entry.instructions.begin(),
+			prologue.begin(), prologue.end());
+	if (opt.finish_block)
+		opt.finish_block(entry.instructions, entry.condition != nullptr);
+	if constexpr (consume)
+		cfg.clear();
 	return ret;
 }
+obj_code translate_to_obj_code(const basic_block::cfg_type &cfg,
+		const options &opt)
+{
+	return translate_cfg(cfg, opt);
+}
+obj_code translate_to_obj_code(basic_block::cfg_type &&cfg,
+		const options &opt)
+{
+	return translate_cfg(cfg, opt);
+}
 void print_obj_code_block(std::ostream &os, const obj_code &code)
 {
 	for (const auto &[line, block] : code)
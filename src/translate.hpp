@@ -1,7 +1,11 @@
 #ifndef TRANSLATE_HPP
 #define TRANSLATE_HPP
+#include "array.hpp"
 #include "basic_block.hpp"
+#include "cache.hpp"
 #include "inst.hpp"
+#include "profile.hpp"
+#include <functional>
 #include <ostream>
 #include <map>
 #include <set>
@@ -19,8 +23,30 @@ struct obj_code_block
 		: instructions(std::move(_insts)), condition(std::move(cond)),
 		jump_true(j_true), jump_false(j_false) {}
 };
-using obj_code = std::map<int, obj_code_block>;
-obj_code translate_to_obj_code(const basic_block::cfg_type &cfg);
+struct obj_code : std::map<int, obj_code_block>
+{
+	int slots = 0; // memory slots the code uses, from sp up
+};
+struct options
+{
+	bool instrument = false; // count block executions and print them at EXIT
+	const profile::counts *prof = nullptr; // weights registers and layout
+	const array::sizes *arrays = nullptr; // arrays the program declares
+	// analyses from pass::manager; with interference the variables are laid
+	// out by weight, hidden ones share locations and constants are pinned
+	const std::map<int, int> *loop_depth = nullptr; // weights, if no prof
+	const basic_block::interference_map *interference = nullptr;
+	cache::store *cache = nullptr; // reuses blocks translated before
+	unsigned jobs = 1; // threads translating blocks; output does not change
+	// run on the code of each block once it is final, on the same threads;
+	// the flag tells if the block ends in a branch on a0
+	std::function<void(std::vector<inst::instruction> &, bool)> finish_block;
+};
+obj_code translate_to_obj_code(const basic_block::cfg_type &cfg,
+		const options &opt = options());
+// the same, freeing each block of cfg once it is translated
+obj_code translate_to_obj_code(basic_block::cfg_type &&cfg,
+		const options &opt = options());
 void print_obj_code_block(std::ostream &os, const obj_code &code);
 }
 #endif
@@ -0,0 +1,406 @@
+#include "value_number.hpp"
+#include <typeinfo>
+#include <tuple>
+#include <map>
+#include <set>
+#include <vector>
+#include <string>
+#include <climits>
+namespace value_number
+{
+using basic_block::cfg_type;
+enum op_kind { ADD, SUB, MUL, DIV, NEG, LT, LE, EQ, NE, AND, OR };
+struct holder
+{
+	std::string var; // empty if the value is held by occurrence occ
+	const expr::expr *occ;
+};
+struct numbering
+{
+	int vn_cnt = 0;
+	std::map<std::tuple<int, int, int>, int> expr_vn;
+	std::map<expr::value_type, int> imm_vn;
+	std::map<const expr::expr *, int> node_vn;
+	// scoped along the dominator tree, restored through undo_log
+	std::map<std::string, int> var_vn;
+	std::map<int, std::vector<holder>> avail;
+	struct log_entry
+	{
+		std::string var; // empty if avail[vn] was pushed
+		int vn; // previous value number of var, INT_MIN if it had none
+	};
+	std::vector<log_entry> undo_log;
+	// redundant occurrence -> where to read it from
+	std::map<const expr::expr *, holder> reuse;
+	// occurrence -> profit of keeping it in a hidden variable
+	std::map<const expr::expr *, int> score;
+
+	void set_var(const std::string &var, int vn)
+	{
+		auto it = var_vn.find(var);
+		undo_log.push_back
+			(log_entry{var, it == var_vn.end() ? INT_MIN : it->second});
+		var_vn[var] = vn;
+	}
+	int get_var(const std::string &var)
+	{
+		if (var_vn.count(var) == 0)
+			set_var(var, vn_cnt++);
+		return var_vn[var];
+	}
+	void push_avail(int vn, holder &&h)
+	{
+		avail[vn].push_back(std::move(h));
+		undo_log.push_back(log_entry{"", vn});
+	}
+	void undo(size_t mark)
+	{
+		while (undo_log.size() > mark)
+		{
+			const auto &entry = undo_log.back();
+			if (entry.var.empty())
+			{
+				auto &holders = avail[entry.vn];
+				holders.pop_back();
+				if (holders.empty())
+					avail.erase(entry.vn);
+			}
+			else if (entry.vn == INT_MIN)
+				var_vn.erase(entry.var);
+			else
+				var_vn[entry.var] = entry.vn;
+			undo_log.pop_back();
+		}
+	}
+	int key_vn(int op, int a, int b)
+	{
+		auto &&[it, inserted] =
+			expr_vn.emplace(std::make_tuple(op, a, b), vn_cnt);
+		if (inserted)
+			++vn_cnt;
+		return it->second;
+	}
+	int value_of(const expr::expr *e)
+	{
+		auto it = node_vn.find(e);
+		if (it != node_vn.end())
+			return it->second;
+		const auto &type = typeid(*e);
+		int ret;
+		if (type == typeid(expr::imm_num))
+		{
+			auto &&[pos, inserted] = imm_vn.emplace
+				(static_cast<const expr::imm_num&>(*e).value, vn_cnt);
+			if (inserted)
+				++vn_cnt;
+			ret = pos->second;
+		}
+		else if (type == typeid(expr::id))
+			ret = get_var(static_cast<const expr::id&>(*e).id_name);
+		else if (type == typeid(expr::neg))
+			ret = key_vn(NEG,
+					value_of(static_cast<const expr::neg&>(*e).c.get()), 0);
+		else if (type == typeid(expr::subscript))
+			ret = vn_cnt++;
+		else
+		{
+			const auto &bin_expr = static_cast<const expr::bin_op&>(*e);
+			int a = value_of(bin_expr.lc.get());
+			int b = value_of(bin_expr.rc.get());
+			int op;
+			bool commutative = false;
+			if (type == typeid(expr::add))
+				op = ADD, commutative = true;
+			else if (type == typeid(expr::sub))
+				op = SUB;
+			else if (type == typeid(expr::mul))
+				op = MUL, commutative = true;
+			else if (type == typeid(expr::div))
+				op = DIV;
+			else if (type == typeid(expr::bool_and))
+				op = AND, commutative = true;
+			else if (type == typeid(expr::bool_or))
+				op = OR, commutative = true;
+			else
+				switch (static_cast<const expr::cmp&>(*e).op)
+				{
+					case expr::cmp::GT:
+						std::swap(a, b);
+						[[fallthrough]];
+					case expr::cmp::LT:
+						op = LT;
+						break;
+					case expr::cmp::GE:
+						std::swap(a, b);
+						[[fallthrough]];
+					case expr::cmp::LE:
+						op = LE;
+						break;
+					case expr::cmp::EQ:
+						op = EQ, commutative = true;
+						break;
+					default:
+						op = NE, commutative = true;
+				}
+			if (commutative && a > b)
+				std::swap(a, b);
+			ret = key_vn(op, a, b);
+		}
+		node_vn[e] = ret;
+		return ret;
+	}
+	void process(const expr::expr *e)
+	{
+		const auto &type = typeid(*e);
+		if (type == typeid(expr::imm_num))
+			return;
+		int vn = value_of(e);
+		bool is_leaf = type == typeid(expr::id);
+		auto it = avail.find(vn);
+		if (it != avail.end())
+		{
+			const holder *found = nullptr;
+			for (auto h = it->second.rbegin(); h != it->second.rend(); ++h)
+				if (h->var.empty())
+				{
+					if (found == nullptr)
+						found = &*h;
+				}
+				else if (!is_leaf && var_vn.count(h->var) != 0
+						&& var_vn.at(h->var) == vn)
+				{
+					found = &*h;
+					break;
+				}
+			if (found != nullptr)
+			{
+				reuse[e] = *found;
+				if (found->var.empty())
+					score[found->occ] += is_leaf ? 1 : 2;
+				return;
+			}
+		}
+		if (type == typeid(expr::neg))
+			process(static_cast<const expr::neg&>(*e).c.get());
+		else if (type == typeid(expr::subscript)) // only the index is shared
+			process(static_cast<const expr::subscript&>(*e).rc.get());
+		else if (!is_leaf)
+		{
+			process(static_cast<const expr::bin_op&>(*e).lc.get());
+			process(static_cast<const expr::bin_op&>(*e).rc.get());
+		}
+		if (type != typeid(expr::subscript))
+			push_avail(vn, holder{"", e});
+	}
+	void assign(const statement::assignment &assign)
+	{
+		process(assign.val.get());
+		if (typeid(*(assign.var)) != typeid(expr::id))
+			return;
+		const auto &name =
+			static_cast<const expr::id&>(*(assign.var)).id_name;
+		int vn = value_of(assign.val.get());
+		set_var(name, vn);
+		push_avail(vn, holder{name, nullptr});
+	}
+	void process(const statement::statement &sent)
+	{
+		const auto &type = typeid(sent);
+		if (type == typeid(statement::LET))
+			assign(static_cast<const statement::LET&>(sent).assign);
+		else if (type == typeid(statement::END_FOR))
+			assign(static_cast<const statement::END_FOR&>(sent)
+					.step_statement);
+		else if (type == typeid(statement::INPUT))
+		{
+			for (const auto &var :
+					static_cast<const statement::INPUT&>(sent).inputs)
+				if (typeid(*var) == typeid(expr::id))
+					set_var(static_cast<const expr::id&>(*var).id_name,
+							vn_cnt++);
+		}
+		else if (type == typeid(statement::EXIT))
+			process(static_cast<const statement::EXIT&>(sent).val.get());
+		else if (type == typeid(statement::IF))
+			process(static_cast<const statement::IF&>(sent).condition.get());
+		else if (type == typeid(statement::FOR))
+			process(static_cast<const statement::FOR&>(sent).condition.get());
+	}
+};
+std::set<std::string>
+assigned_vars(const basic_block::basic_block_type &block)
+{
+	std::set<std::string> ret;
+	auto add_lvalue = [&ret](const std::unique_ptr<expr::expr> &var)
+	{
+		if (typeid(*var) == typeid(expr::id))
+			ret.insert(static_cast<const expr::id&>(*var).id_name);
+	};
+	for (const auto &sent : block.commands)
+	{
+		const auto &type = typeid(*sent);
+		if (type == typeid(statement::LET))
+			add_lvalue(static_cast<const statement::LET&>(*sent).assign.var);
+		else if (type == typeid(statement::END_FOR))
+			add_lvalue(static_cast<const statement::END_FOR&>(*sent)
+					.step_statement.var);
+		else if (type == typeid(statement::INPUT))
+			for (const auto &var :
+					static_cast<const statement::INPUT&>(*sent).inputs)
+				add_lvalue(var);
+	}
+	return ret;
+}
+struct rewriter
+{
+	const numbering &nb;
+	std::map<const expr::expr *, std::string> temp_of;
+	std::vector<std::unique_ptr<expr::expr>> graveyard;
+	int temp_cnt = 0;
+	rewriter(const numbering &_nb) : nb(_nb) {}
+	void replace(std::unique_ptr<expr::expr> &slot, const std::string &name)
+	{
+		graveyard.push_back(std::move(slot));
+		slot = std::make_unique<expr::id>(name);
+	}
+	void rewrite(std::unique_ptr<expr::expr> &slot,
+			std::vector<std::unique_ptr<statement::statement>> &out)
+	{
+		const expr::expr *e = slot.get();
+		auto r = nb.reuse.find(e);
+		if (r != nb.reuse.end())
+		{
+			const auto &h = r->second;
+			if (!h.var.empty())
+				return replace(slot, h.var);
+			auto t = temp_of.find(h.occ);
+			if (t != temp_of.end())
+				return replace(slot, t->second);
+		}
+		const auto &type = typeid(*e);
+		if (type == typeid(expr::neg))
+			rewrite(static_cast<expr::neg&>(*slot).c, out);
+		else if (type == typeid(expr::subscript))
+			rewrite(static_cast<expr::subscript&>(*slot).rc, out);
+		else if (type != typeid(expr::id) && type != typeid(expr::imm_num))
+		{
+			rewrite(static_cast<expr::bin_op&>(*slot).lc, out);
+			rewrite(static_cast<expr::bin_op&>(*slot).rc, out);
+		}
+		auto s = nb.score.find(e);
+		if (s == nb.score.end() || s->second < 2)
+			return;
+		auto name = '$' + std::to_string(++temp_cnt);
+		temp_of[e] = name;
+		out.push_back(std::make_unique<statement::LET>(statement::assignment
+				(std::make_unique<expr::id>(name), std::move(slot))));
+		slot = std::make_unique<expr::id>(name);
+	}
+	void rewrite(basic_block::basic_block_type &block)
+	{
+		std::vector<std::unique_ptr<statement::statement>> commands;
+		for (auto &sent : block.commands)
+		{
+			const auto &type = typeid(*sent);
+			if (type == typeid(statement::LET))
+				rewrite(static_cast<statement::LET&>(*sent).assign.val,
+						commands);
+			else if (type == typeid(statement::END_FOR))
+				rewrite(static_cast<statement::END_FOR&>(*sent)
+						.step_statement.val, commands);
+			else if (type == typeid(statement::EXIT))
+				rewrite(static_cast<statement::EXIT&>(*sent).val, commands);
+			else if (type == typeid(statement::IF))
+				rewrite(static_cast<statement::IF&>(*sent).condition,
+						commands);
+			else if (type == typeid(statement::FOR))
+				rewrite(static_cast<statement::FOR&>(*sent).condition,
+						commands);
+			commands.push_back(std::move(sent));
+		}
+		block.commands = std::move(commands);
+		if (block.condition == nullptr)
+			return;
+		const auto &last = *block.commands.back();
+		if (typeid(last) == typeid(statement::IF))
+			block.condition =
+				static_cast<const statement::IF&>(last).condition->deep_copy();
+		else
+			block.condition =
+				static_cast<const statement::FOR&>(last).condition->deep_copy();
+	}
+};
+void eliminate_redundancy(cfg_type &cfg)
+{
+	eliminate_redundancy(cfg, basic_block::gen_idom(cfg));
+}
+void eliminate_redundancy(cfg_type &cfg, const std::map<int, int> &idom)
+{
+	if (idom.empty())
+		return;
+	auto pred = basic_block::gen_predecessors(cfg);
+	std::map<int, std::vector<int>> children;
+	std::map<int, std::set<std::string>> kill;
+	for (const auto &[id, dom] : idom)
+	{
+		if (id != dom)
+			children[dom].push_back(id);
+		kill[id] = assigned_vars(cfg.at(id));
+	}
+	// variables that may change on the way from idom[b] to b
+	auto region_kill = [&](int b)
+	{
+		std::set<std::string> ret;
+		int d = idom.at(b);
+		const auto &b_pred = pred[b];
+		if (b == d || (b_pred.size() == 1 && b_pred[0] == d))
+			return ret;
+		std::set<int> visited;
+		std::vector<int> stack;
+		for (auto p : b_pred)
+			if (p != d && visited.insert(p).second)
+				stack.push_back(p);
+		while (!stack.empty())
+		{
+			int x = stack.back();
+			stack.pop_back();
+			ret.insert(kill[x].begin(), kill[x].end());
+			for (auto p : pred[x])
+				if (p != d && visited.insert(p).second)
+					stack.push_back(p);
+		}
+		return ret;
+	};
+	numbering nb;
+	struct frame
+	{
+		int block;
+		size_t next_child, mark;
+	};
+	std::vector<frame> stack;
+	auto enter = [&](int b)
+	{
+		stack.push_back(frame{b, 0, nb.undo_log.size()});
+		for (const auto &var : region_kill(b))
+			nb.set_var(var, nb.vn_cnt++);
+		for (const auto &sent : cfg.at(b).commands)
+			nb.process(*sent);
+	};
+	enter(cfg.begin()->first);
+	while (!stack.empty())
+	{
+		auto &top = stack.back();
+		const auto &child = children[top.block];
+		if (top.next_child < child.size())
+			enter(child[top.next_child++]);
+		else
+		{
+			nb.undo(top.mark);
+			stack.pop_back();
+		}
+	}
+	rewriter rw(nb);
+	for (auto id : basic_block::reverse_post_order(cfg))
+		rw.rewrite(cfg.at(id));
+}
+}
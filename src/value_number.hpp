@@ -0,0 +1,18 @@
+#ifndef VALUE_NUMBER_HPP
+#define VALUE_NUMBER_HPP
+#include "basic_block.hpp"
+namespace value_number
+{
+/*
+ * Numbers the values of all expressions along the dominator tree and rewrites
+ * every occurrence whose value is still available.  The value is read back
+ * from the variable it was assigned to, or from a hidden variable ($1, $2...)
+ * set up right before the statement that first computes it.
+ */
+void eliminate_redundancy(basic_block::cfg_type &cfg);
+// the same, given basic_block::gen_idom(cfg), which stays valid: blocks and
+// jumps are left as they are
+void eliminate_redundancy(basic_block::cfg_type &cfg,
+		const std::map<int, int> &idom);
+}
+#endif
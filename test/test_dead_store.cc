@@ -0,0 +1,18 @@
+#include "../src/dead_store.hpp"
+#include "../src/partial_eval.hpp"
+#include <iostream>
+int main()
+{
+	try
+	{
+		auto &&prog = statement::read_program(std::cin);
+		auto &&cfg = basic_block::gen_cfg(prog);
+		partial_eval::evaluate(cfg);
+		dead_store::eliminate(cfg);
+		basic_block::print_cfg(std::cout, cfg);
+	}
+	catch (const char *e)
+	{
+		std::cerr << e << std::endl;
+	}
+}
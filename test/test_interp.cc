@@ -0,0 +1,15 @@
+#include "../src/interp.hpp"
+#include <iostream>
+int main()
+{
+	try
+	{
+		auto &&prog = statement::read_program(std::cin);
+		auto &&arrays = array::lower(prog);
+		interp::print_program(std::cout, interp::compile(prog, arrays));
+	}
+	catch (const char *e)
+	{
+		std::cerr << e << std::endl;
+	}
+}
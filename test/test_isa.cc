@@ -0,0 +1,58 @@
+#include "../src/isa.hpp"
+#include <iostream>
+#include <random>
+using namespace inst;
+// zeroes the fields the format does not encode and clamps the immediate
+instruction canonical(instruction x, std::mt19937 &gen)
+{
+	auto rand_in = [&](int lo, int hi)
+	{
+		return std::uniform_int_distribution<int>(lo, hi)(gen);
+	};
+	switch (isa::describe(x.op).fmt)
+	{
+		case isa::format::R: x.imm = 0; break;
+		case isa::format::I:
+		case isa::format::L: x.rs2 = 0; x.imm = rand_in(-2048, 2047); break;
+		case isa::format::SHIFT: x.rs2 = 0; x.imm = rand_in(0, 31); break;
+		case isa::format::SYS: x = instruction{x.op, 0, 0, 0, 0}; break;
+		case isa::format::S: x.rd = 0; x.imm = rand_in(-2048, 2047); break;
+		case isa::format::B:
+			x.rd = 0;
+			x.imm = rand_in(-2048, 2047) * 2;
+			break;
+		case isa::format::U:
+			x.rs1 = x.rs2 = 0;
+			x.imm = rand_in(INT32_MIN >> 12, INT32_MAX >> 12) * 4096;
+			break;
+		case isa::format::J:
+			x.rs1 = x.rs2 = 0;
+			x.imm = rand_in(-(1 << 19), (1 << 19) - 1) * 2;
+	}
+	return x;
+}
+// Reads the number of random instructions to try for every opcode.
+int main()
+{
+	int n;
+	std::cin >> n;
+	std::mt19937 gen(1);
+	std::uniform_int_distribution<int> reg(0, REAL_REG - 1);
+	int bad = 0;
+	for (const auto &d : isa::table)
+		for (int i = 0; i < n; ++i)
+		{
+			auto x = canonical(instruction{d.op, reg(gen), reg(gen), 0, reg(gen)},
+					gen);
+			uint32_t raw = isa::encode(x);
+			auto y = isa::decode(raw);
+			if (y.op != x.op || y.rs1 != x.rs1 || y.rs2 != x.rs2
+					|| y.imm != x.imm || y.rd != x.rd || isa::encode(y) != raw)
+			{
+				std::cout << x << " decoded as " << y << std::endl;
+				++bad;
+			}
+		}
+	std::cout << std::size(isa::table) << " opcodes, " << bad << " failures"
+		<< std::endl;
+}
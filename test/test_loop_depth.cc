@@ -0,0 +1,52 @@
+#include "../src/basic_block.hpp"
+#include <chrono>
+#include <iostream>
+#include <sstream>
+// Reads counts n; for each, builds a straight chain of n IFs followed by a
+// loop nest two deep, and times loop_depth on it.  The chain must come out at
+// depth 0 and the nest at 1 and 2, within a second even for n in the tens of
+// thousands.
+int main()
+{
+	const long LIMIT_MS = 1000;
+	for (long n; std::cin >> n; )
+	{
+		std::ostringstream src;
+		src << "10 INPUT x\n";
+		long line = 20;
+		for (long i = 0; i < n; ++i, line += 20)
+			src << line << " IF x < " << i << " THEN " << line + 20 << '\n'
+				<< line + 10 << " LET x = x + 1\n";
+		long outer = line, inner = line + 10;
+		src << outer << " LET x = x - 1\n"
+			<< inner << " LET x = x + 2\n"
+			<< inner + 10 << " IF x < 0 THEN " << inner << '\n'
+			<< inner + 20 << " IF x > 100 THEN " << outer << '\n'
+			<< inner + 30 << " EXIT x\n";
+		std::istringstream is(src.str());
+		try
+		{
+			auto &&prog = statement::read_program(is);
+			auto &&cfg = basic_block::gen_cfg(prog);
+			using clock = std::chrono::steady_clock;
+			auto t0 = clock::now();
+			auto &&depth = basic_block::loop_depth(cfg);
+			long ms = std::chrono::duration_cast<std::chrono::milliseconds>
+				(clock::now() - t0).count();
+			int max_depth = 0;
+			long in_loop = 0;
+			for (const auto &[id, d] : depth)
+			{
+				max_depth = std::max(max_depth, d);
+				in_loop += d != 0;
+			}
+			std::cout << n << " IFs: " << depth.size() << " blocks, "
+				<< in_loop << " in loops, depth " << max_depth << ", " << ms
+				<< " ms" << (ms > LIMIT_MS ? " SLOW" : "") << std::endl;
+		}
+		catch (const char *e)
+		{
+			std::cerr << e << std::endl;
+		}
+	}
+}
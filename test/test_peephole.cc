@@ -0,0 +1,23 @@
+#include "../src/peephole.hpp"
+#include "../src/value_number.hpp"
+#include <iostream>
+int main()
+{
+	try
+	{
+		auto &&prog = statement::read_program(std::cin);
+		auto &&cfg = basic_block::gen_cfg(prog);
+		value_number::eliminate_redundancy(cfg);
+		auto &&obj_code = translate::translate_to_obj_code(cfg);
+		peephole::stats st;
+		peephole::optimize_obj_code(obj_code, st);
+		auto &&linked_code = link::link(obj_code);
+		peephole::optimize_linked(linked_code, st);
+		link::print_linked_code(std::cout, linked_code);
+		peephole::print_stats(std::cout, st);
+	}
+	catch (const char *e)
+	{
+		std::cerr << e << std::endl;
+	}
+}
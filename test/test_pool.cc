@@ -0,0 +1,35 @@
+#include "../src/pool.hpp"
+#include <atomic>
+#include <iostream>
+#include <vector>
+// Reads task and thread counts; every task must run once, and the error of
+// the lowest failing index must come out.
+int main()
+{
+	size_t n;
+	unsigned threads;
+	while (std::cin >> n >> threads)
+	{
+		std::vector<std::atomic<int>> runs(n);
+		pool::for_each(n, [&](size_t i) { ++runs[i]; }, threads);
+		bool once = true;
+		for (const auto &r : runs)
+			once = once && r == 1;
+		const char *error = "none";
+		try
+		{
+			pool::for_each(n, [&](size_t i)
+			{
+				if (i % 7 == 3)
+					throw i < 10 ? "first" : "later";
+			}, threads);
+		}
+		catch (const char *e)
+		{
+			error = e;
+		}
+		std::cout << n << " tasks on " << threads << " threads: "
+			<< (once ? "each ran once" : "WRONG COUNT") << ", error "
+			<< error << std::endl;
+	}
+}
@@ -0,0 +1,109 @@
+#include "../src/rvc.hpp"
+#include "../src/isa.hpp"
+#include "../src/peephole.hpp"
+#include <cstring>
+#include <iostream>
+#include <sstream>
+using namespace inst;
+// Runs an RV32 image with the in-tree decoders; INPUT reads 1, 2, 3, ...
+std::string run(const to_raw::raw_prog &image, long &steps)
+{
+	std::vector<uint8_t> mem(0x20000);
+	std::copy(image.begin(), image.end(), mem.begin());
+	auto word = [&](uint32_t addr) -> uint32_t &
+	{
+		if (addr + 4 > mem.size() || addr % 4 != 0)
+			throw "Bad address.";
+		return *reinterpret_cast<uint32_t *>(&mem[addr]);
+	};
+	std::ostringstream out;
+	uint32_t reg[REAL_REG] = {}, pc = 0;
+	int next_input = 1;
+	const long MAX_STEPS = 10000000;
+	for (steps = 0; steps < MAX_STEPS; ++steps)
+	{
+		uint16_t half;
+		std::memcpy(&half, &mem.at(pc), 2);
+		bool compressed = (half & 0b11) != 0b11;
+		uint32_t raw;
+		std::memcpy(&raw, &mem.at(pc), 4);
+		auto x = compressed ? rvc::expand(half) : isa::decode(raw);
+		uint32_t a = reg[x.rs1], b = reg[x.rs2], r = 0;
+		uint32_t next_pc = pc + (compressed ? 2 : 4);
+		switch (x.op)
+		{
+			case inst_op::ADD: r = a + b; break;
+			case inst_op::SUB: r = a - b; break;
+			case inst_op::MUL: r = a * b; break;
+			case inst_op::MULH:
+				r = int64_t(int32_t(a)) * int32_t(b) >> 32;
+				break;
+			case inst_op::DIV:
+				r = b == 0 ? -1 : int32_t(a) == INT32_MIN && int32_t(b) == -1
+					? a : int32_t(a) / int32_t(b);
+				break;
+			case inst_op::AND: r = a & b; break;
+			case inst_op::OR: r = a | b; break;
+			case inst_op::SLT: r = int32_t(a) < int32_t(b); break;
+			case inst_op::ADDI: r = a + x.imm; break;
+			case inst_op::SLTIU: r = a < uint32_t(x.imm); break;
+			case inst_op::SLTI: r = int32_t(a) < x.imm; break;
+			case inst_op::XORI: r = a ^ x.imm; break;
+			case inst_op::SLLI: r = a << x.imm; break;
+			case inst_op::SRLI: r = a >> x.imm; break;
+			case inst_op::SRAI: r = int32_t(a) >> x.imm; break;
+			case inst_op::LUI: r = x.imm; break;
+			case inst_op::AUIPC: r = pc + x.imm; break;
+			case inst_op::LW: r = word(a + x.imm); break;
+			case inst_op::SW: word(a + x.imm) = b; break;
+			case inst_op::JAL: r = next_pc; next_pc = pc + x.imm; break;
+			case inst_op::JALR: r = next_pc; next_pc = (a + x.imm) & ~1u; break;
+			case inst_op::BEQ:
+				if (a == b)
+					next_pc = pc + x.imm;
+				break;
+			case inst_op::ECALL:
+				if (reg[a0] == CALL_EXIT)
+				{
+					out << "EXIT " << int32_t(reg[a1]);
+					return out.str();
+				}
+				if (reg[a0] == CALL_PRINT)
+					out << "PRINT " << int32_t(reg[a1]) << '\n';
+				r = reg[a0] == CALL_READ ? next_input++ : reg[a0];
+				break;
+		}
+		if (dst_reg(x) > 0)
+			reg[dst_reg(x)] = r;
+		pc = next_pc;
+	}
+	return out.str() + "TIMEOUT";
+}
+// Compares the program from stdin with and without compressed instructions.
+int main()
+{
+	try
+	{
+		auto &&prog = statement::read_program(std::cin);
+		auto &&cfg = basic_block::gen_cfg(prog);
+		auto &&obj_code = translate::translate_to_obj_code(cfg);
+		peephole::stats st;
+		peephole::optimize_obj_code(obj_code, st);
+		auto &&linked_code = link::link(obj_code);
+		peephole::optimize_linked(linked_code, st);
+		auto &&plain = to_raw::to_raw_prog(linked_code);
+		auto &&compressed = rvc::assemble(linked_code);
+		long plain_steps, compressed_steps;
+		auto &&plain_out = run(plain, plain_steps);
+		auto &&compressed_out = run(compressed, compressed_steps);
+		std::cout << plain_out << '\n'
+			<< (plain_out == compressed_out ? "same" : "DIFFERENT")
+			<< " behaviour, " << plain.size() << " -> " << compressed.size()
+			<< " bytes, " << plain_steps << " -> " << compressed_steps
+			<< " steps" << std::endl;
+	}
+	catch (const char *e)
+	{
+		std::cerr << e << std::endl;
+	}
+}
@@ -0,0 +1,29 @@
+#include "../src/schedule.hpp"
+#include <iostream>
+int main()
+{
+	try
+	{
+		auto &&prog = statement::read_program(std::cin);
+		auto &&cfg = basic_block::gen_cfg(prog);
+		auto &&obj_code = translate::translate_to_obj_code(cfg);
+		auto &&model = schedule::default_model();
+		auto total_cycles = [&]()
+		{
+			long ret = 0;
+			for (const auto &[id, block] : obj_code)
+				ret += schedule::estimate_cycles(block.instructions, model,
+						block.jump_true != basic_block::END_IDX);
+			return ret;
+		};
+		long before = total_cycles();
+		schedule::schedule_obj_code(obj_code, model);
+		translate::print_obj_code_block(std::cout, obj_code);
+		std::cout << "cycles: " << before << " -> " << total_cycles()
+			<< std::endl;
+	}
+	catch (const char *e)
+	{
+		std::cerr << e << std::endl;
+	}
+}
@@ -0,0 +1,61 @@
+#include "../src/strength.hpp"
+#include <cstdint>
+#include <iostream>
+using namespace inst;
+int32_t run(const std::vector<instruction> &code, int x, int32_t x_val, int ans)
+{
+	uint32_t reg[REAL_REG] = {};
+	reg[x] = x_val;
+	for (const auto &i : code)
+	{
+		uint32_t a = reg[i.rs1], b = reg[i.rs2], r;
+		switch (i.op)
+		{
+			case inst_op::ADD: r = a + b; break;
+			case inst_op::SUB: r = a - b; break;
+			case inst_op::ADDI: r = a + i.imm; break;
+			case inst_op::LUI: r = i.imm; break;
+			case inst_op::SLLI: r = a << i.imm; break;
+			case inst_op::SRLI: r = a >> i.imm; break;
+			case inst_op::SRAI: r = int32_t(a) >> i.imm; break;
+			case inst_op::MULH:
+				r = int64_t(int32_t(a)) * int32_t(b) >> 32;
+				break;
+			default:
+				std::cout << "unexpected " << i << std::endl;
+				return 0;
+		}
+		if (i.rd != zero)
+			reg[i.rd] = r;
+	}
+	return reg[ans];
+}
+int main()
+{
+	// divisors and multipliers in [lo, hi] against a fixed set of operands
+	int lo, hi, bad = 0;
+	std::cin >> lo >> hi;
+	std::vector<int32_t> vals = {INT32_MIN, INT32_MIN + 1, INT32_MAX,
+		INT32_MAX - 1, 0x40000000, -0x40000000};
+	for (int v = -1024; v <= 1024; ++v)
+		vals.push_back(v);
+	for (uint32_t v = 1; v < 0x80000000u; v = v * 3 + 7)
+		vals.insert(vals.end(), {int32_t(v), -int32_t(v)});
+	for (int64_t imm = lo; imm <= hi; ++imm)
+		for (int ans : {12, t0})
+		{
+			std::vector<instruction> mul_seq, div_seq;
+			bool has_mul = strength::mul_by_imm(t0, imm, ans, mul_seq);
+			bool has_div = strength::div_by_imm(t0, imm, ans, div_seq);
+			for (int32_t v : vals)
+			{
+				if (has_mul && run(mul_seq, t0, v, ans)
+						!= int32_t(uint32_t(v) * uint32_t(imm)))
+					++bad, std::cout << v << " * " << imm << std::endl;
+				int32_t q = imm == -1 ? -uint32_t(v) : imm == 0 ? 0 : v / imm;
+				if (has_div && run(div_seq, t0, v, ans) != q)
+					++bad, std::cout << v << " / " << imm << std::endl;
+			}
+		}
+	std::cout << (bad == 0 ? "ok" : "failed") << std::endl;
+}
@@ -0,0 +1,40 @@
+#include "../src/to_raw.hpp"
+#include <chrono>
+#include <iostream>
+#include <sstream>
+// Compares print_raw_prog and write_hex on the program from stdin, repeated
+// until it is large enough to time.
+int main()
+{
+	const size_t MIN_SIZE = 1 << 22;
+	try
+	{
+		auto &&prog = statement::read_program(std::cin);
+		auto &&cfg = basic_block::gen_cfg(prog);
+		auto &&obj_code = translate::translate_to_obj_code(cfg);
+		auto &&linked_code = link::link(obj_code);
+		link::linked_prog code;
+		while (code.size() < MIN_SIZE)
+			code.insert(code.end(), linked_code.begin(), linked_code.end());
+		using clock = std::chrono::steady_clock;
+		auto ms = [](clock::duration d)
+		{
+			return std::chrono::duration_cast<std::chrono::milliseconds>(d)
+				.count();
+		};
+		std::ostringstream old_os, new_os;
+		auto t0 = clock::now();
+		to_raw::print_raw_prog(old_os, to_raw::to_raw_prog(code));
+		auto t1 = clock::now();
+		to_raw::write_hex(new_os, code);
+		auto t2 = clock::now();
+		std::cout << (old_os.str() == new_os.str() ? "same" : "DIFFERENT")
+			<< " output, " << code.size() << " instructions\n"
+			<< "print_raw_prog: " << ms(t1 - t0) << " ms\n"
+			<< "write_hex: " << ms(t2 - t1) << " ms" << std::endl;
+	}
+	catch (const char *e)
+	{
+		std::cerr << e << std::endl;
+	}
+}
@@ -5,8 +5,11 @@ int main()
 	try
 	{
 		auto &&prog = statement::read_program(std::cin);
+		auto &&arrays = array::lower(prog);
 		auto &&cfg = basic_block::gen_cfg(prog);
-		auto &&obj_code = translate::translate_to_obj_code(cfg);
+		translate::options opt;
+		opt.arrays = &arrays;
+		auto &&obj_code = translate::translate_to_obj_code(cfg, opt);
 		translate::print_obj_code_block(std::cout, obj_code);
 	}
 	catch (const char *e)
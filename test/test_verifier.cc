@@ -0,0 +1,146 @@
+#include "../src/pass.hpp"
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <sstream>
+// Reads a program with an IF after another statement in one block, and
+// breaks one invariant at a time before a stage of pass::manager runs with
+// --verify-passes.  Every case must print the verifier's "invariant broken
+// by" line from the log and the error; a case that gets through prints MISSED.
+using basic_block::cfg_type;
+using inst::instruction;
+using inst::inst_op;
+struct test_case
+{
+	const char *name;
+	std::function<void(cfg_type &, pass::manager &)> cfg;
+	std::function<void(translate::obj_code &)> code;
+	std::function<void(link::linked_prog &)> linked;
+};
+// the first block with a condition and another command before the branch
+basic_block::basic_block_type &branch_block(cfg_type &cfg)
+{
+	for (auto &[id, block] : cfg)
+		if (block.condition != nullptr && block.commands.size() > 1)
+			return block;
+	throw "No IF after another statement in a block.";
+}
+void push_front(translate::obj_code &code, const instruction &x)
+{
+	auto &insts = code.begin()->second.instructions;
+	insts.insert(insts.begin(), x);
+}
+const test_case cases[] = {
+	{"missing block", [](cfg_type &cfg, pass::manager &)
+		{
+			cfg.begin()->second.jump_true = 1 << 30;
+		}, nullptr, nullptr},
+	{"jump mid-block", [](cfg_type &cfg, pass::manager &)
+		{
+			auto &commands = branch_block(cfg).commands;
+			std::rotate(commands.begin(), commands.end() - 1, commands.end());
+		}, nullptr, nullptr},
+	{"lost branch", [](cfg_type &cfg, pass::manager &)
+		{
+			branch_block(cfg).commands.pop_back();
+		}, nullptr, nullptr},
+	{"hidden twice", [](cfg_type &cfg, pass::manager &)
+		{
+			auto &commands = cfg.begin()->second.commands;
+			for (int i = 0; i < 2; ++i)
+				commands.insert(commands.begin(),
+						std::make_unique<statement::LET>(statement::assignment(
+							std::make_unique<expr::id>("$0"),
+							std::make_unique<expr::imm_num>(1))));
+		}, nullptr, nullptr},
+	// value-number says it keeps the dominators, so changing the jumps
+	// behind its back must show up once it has run
+	{"stale dominators", [](cfg_type &cfg, pass::manager &passes)
+		{
+			passes.dominators(cfg);
+			auto &entry = cfg.begin()->second;
+			entry.jump_true = entry.jump_false = basic_block::END_IDX;
+		}, nullptr, nullptr},
+	{"sp written", nullptr, [](translate::obj_code &code)
+		{
+			using namespace inst;
+			push_front(code, instruction{inst_op::ADDI, sp, 0, 4, sp});
+		}, nullptr},
+	{"large immediate", nullptr, [](translate::obj_code &code)
+		{
+			using namespace inst;
+			push_front(code, instruction{inst_op::ADDI, zero, 0, 5000, a0});
+		}, nullptr},
+	{"bad register", nullptr, [](translate::obj_code &code)
+		{
+			using namespace inst;
+			push_front(code, instruction{inst_op::ADDI, zero, 0, 0, 40});
+		}, nullptr},
+	{"jump out", nullptr, nullptr, [](link::linked_prog &code)
+		{
+			code.push_back(instruction{inst_op::JAL, 0, 0, 8, inst::zero});
+		}},
+	{"none", nullptr, nullptr, nullptr},
+};
+// the stages of the driver, with c breaking one of their inputs
+void run(const statement::program_type &prog, const test_case &c,
+		std::ostream &log)
+{
+	pass::options opt;
+	opt.opt_level = pass::level::O1;
+	opt.verify = true;
+	pass::manager passes(opt, log);
+	std::ostringstream warnings;
+	auto &&cfg = basic_block::gen_cfg(prog, warnings);
+	if (c.cfg)
+		c.cfg(cfg, passes);
+	passes.run_cfg(cfg);
+	translate::options to;
+	passes.prepare_layout(cfg, to);
+	auto &&obj_code = translate::translate_to_obj_code(cfg, to);
+	if (c.code)
+		c.code(obj_code);
+	passes.run_code(obj_code);
+	link::symbol_table symbols;
+	auto &&linked_code = link::link(obj_code, nullptr, &symbols);
+	if (c.linked)
+		c.linked(linked_code);
+	passes.run_linked(linked_code, symbols);
+}
+int main()
+{
+	try
+	{
+		auto &&prog = statement::read_program(std::cin);
+		for (const auto &c : cases)
+		{
+			std::ostringstream log;
+			const char *error = nullptr;
+			try
+			{
+				run(prog, c, log);
+			}
+			catch (const char *e)
+			{
+				error = e;
+			}
+			auto line = log.str();
+			if (!line.empty() && line.back() == '\n')
+				line.pop_back();
+			bool broken = error != nullptr
+				&& line.find("verifier: invariant broken by")
+					!= std::string::npos;
+			bool corrupt = c.cfg || c.code || c.linked;
+			std::cout << c.name << ": ";
+			if (error != nullptr)
+				std::cout << line << (line.empty() ? "" : ": ") << error;
+			else
+				std::cout << "ok";
+			std::cout << (corrupt && !broken ? " MISSED" : "") << std::endl;
+		}
+	}
+	catch (const char *e)
+	{
+		std::cerr << e << std::endl;
+	}
+}